@@ -35,6 +35,12 @@ void ShowUsage(const std::string& exe_path)
 		<< "-a --analyze  \tDefault: flag is not set\n"
 		<< "-o --optimize \tDefault: flag is not set\n"
 		<< "-r --repair   \tDefault: flag is not set\n"
+		<< "--partial-eval\trun the code before the first input when compiling, implies -o\n"
+		<< "--engine [switch|threaded|jit] or --jit\tDefault: switch\n"
+		<< "--quantum [<1, 2^32>|loop] instructions between thread switches\tDefault: 256\n"
+		<< "--threads [system|pool|fiber] a system thread for every fork, a worker per core or fibers\tDefault: system\n"
+		<< "--blocking-heap ~^ on an empty shared heap waits for a ~&\tDefault: flag is not set\n"
+		<< "--emit-c [filename|-] translate the code to C instead of running it\n"
 		<< "--nopause     \tDefault: flag is not set\n"
 		<< "--verbose [all|important|none]\tDefault: important\n"
 		<< "You can use these parameters in the interactive mode by typing 'set [params]'\n"
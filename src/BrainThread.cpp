@@ -1,11 +1,15 @@
 #include <memory>
 #include <chrono>
 #include <sstream>
+#include <fstream>
 
 #include "BrainThread.h"
 #include "Interpreter.h"
+#include "JitInterpreter.h"
 #include "Parser.h"
 #include "CodeAnalyser.h"
+#include "CodeGenerator.h"
+#include "PrefixEvaluator.h"
 
 using namespace BT;
 
@@ -20,8 +24,15 @@ using namespace BT;
             RunAnalyser(parser, flags);
         }
 
+        if (flags.OP_partial_eval && parser.IsSyntaxValid()) {
+            EvaluatePrefix(parser, flags);
+        }
+
         auto exec_start = std::chrono::system_clock::now();
-        if (parser.IsSyntaxValid() && flags.OP_execute) {
+        if (parser.IsSyntaxValid() && !flags.OP_emit_c_path.empty()) {
+            EmitC(parser.GetInstructions(), flags);
+        }
+        else if (parser.IsSyntaxValid() && flags.OP_execute) {
             ProduceInterpreter(flags)->Run(parser.GetInstructions());
         }
 
@@ -47,51 +58,119 @@ namespace BT
         {
             case CodeLang::clBrainThread:
             {
-                if (flags.OP_analyse) return Parser<CodeLang::clBrainThread, 0>(code);
-                else if (flags.OP_optimize) return Parser<CodeLang::clBrainThread, 2>(code);
+                if (flags.OP_optimize) return Parser<CodeLang::clBrainThread, 2>(code);
+                else if (flags.OP_analyse) return Parser<CodeLang::clBrainThread, 0>(code);
                 else return Parser<CodeLang::clBrainThread, 1>(code);
             }
             break;
             case CodeLang::clPBrain:
             {
-                if (flags.OP_analyse) return Parser<CodeLang::clPBrain, 0>(code);
-                else if (flags.OP_optimize) return Parser<CodeLang::clPBrain, 2>(code);
+                if (flags.OP_optimize) return Parser<CodeLang::clPBrain, 2>(code);
+                else if (flags.OP_analyse) return Parser<CodeLang::clPBrain, 0>(code);
                 else return Parser<CodeLang::clPBrain, 1>(code);
             }
             break;
             case CodeLang::clBrainFork:
             {
-                if (flags.OP_analyse) return Parser<CodeLang::clBrainFork, 0>(code);
-                else if (flags.OP_optimize) return Parser<CodeLang::clBrainFork, 2>(code);
+                if (flags.OP_optimize) return Parser<CodeLang::clBrainFork, 2>(code);
+                else if (flags.OP_analyse) return Parser<CodeLang::clBrainFork, 0>(code);
                 else return Parser<CodeLang::clBrainFork, 1>(code);
             }
             case CodeLang::clBrainFuck:
             default:
             {
-                if (flags.OP_analyse) return Parser<CodeLang::clBrainFuck, 0>(code);
-                else if (flags.OP_optimize) return Parser<CodeLang::clBrainFuck, 2>(code);
+                if (flags.OP_optimize) return Parser<CodeLang::clBrainFuck, 2>(code);
+                else if (flags.OP_analyse) return Parser<CodeLang::clBrainFuck, 0>(code);
                 else return Parser<CodeLang::clBrainFuck, 1>(code);
             }
         }
     }
 
+    //every cell size, memory and EOF behavior gets its own interpreter, the switches run once per program
+    template < typename T, mem_option M, eof_option E >
+    std::unique_ptr<InterpreterBase> ProduceInterpreterFor(const Settings& flags)
+    {
+        if (flags.OP_engine == engine_option::enJit)
+            return std::make_unique<JitInterpreter<T, M, E>>(flags.OP_mem_size, flags.OP_yield_quantum, flags.OP_threads, flags.OP_blocking_heap);
+
+        return std::make_unique<Interpreter<T, M, E>>(flags.OP_mem_size, flags.OP_engine, flags.OP_yield_quantum, flags.OP_threads, flags.OP_blocking_heap);
+    }
+
+    template < typename T, mem_option M >
+    std::unique_ptr<InterpreterBase> ProduceInterpreterFor(const Settings& flags)
+    {
+        switch (flags.OP_eof_behavior)
+        {
+            case eof_option::eoMinusOne: return ProduceInterpreterFor<T, M, eof_option::eoMinusOne>(flags);
+            case eof_option::eoUnchanged: return ProduceInterpreterFor<T, M, eof_option::eoUnchanged>(flags);
+            case eof_option::eoZero:
+            default: return ProduceInterpreterFor<T, M, eof_option::eoZero>(flags);
+        }
+    }
+
+    template < typename T >
+    std::unique_ptr<InterpreterBase> ProduceInterpreterFor(const Settings& flags)
+    {
+        switch (flags.OP_mem_behavior)
+        {
+            case mem_option::moDynamic: return ProduceInterpreterFor<T, mem_option::moDynamic>(flags);
+            case mem_option::moContinuousTape: return ProduceInterpreterFor<T, mem_option::moContinuousTape>(flags);
+            case mem_option::moLimited:
+            default: return ProduceInterpreterFor<T, mem_option::moLimited>(flags);
+        }
+    }
+
     std::unique_ptr<InterpreterBase> ProduceInterpreter(const Settings& flags)
     {
         switch (flags.OP_cellsize)
         {
-            case cellsize_option::cs16: return std::make_unique<Interpreter<short>>(flags.OP_mem_behavior, flags.OP_eof_behavior, flags.OP_mem_size);
-            break;
-            case cellsize_option::cs32: return std::make_unique <Interpreter<int>>(flags.OP_mem_behavior, flags.OP_eof_behavior, flags.OP_mem_size);
-            break;
-            case  cellsize_option::csu8: return std::make_unique<Interpreter<unsigned char>>(flags.OP_mem_behavior, flags.OP_eof_behavior, flags.OP_mem_size);
-            break;
-            case  cellsize_option::csu16: return std::make_unique<Interpreter<unsigned short>>(flags.OP_mem_behavior, flags.OP_eof_behavior, flags.OP_mem_size);
-            break;
-            case  cellsize_option::csu32: return std::make_unique<Interpreter<unsigned int>>(flags.OP_mem_behavior, flags.OP_eof_behavior, flags.OP_mem_size);
-            break;
-            case cellsize_option::cs8: 
-            default: return std::make_unique<Interpreter<char>>(flags.OP_mem_behavior, flags.OP_eof_behavior, flags.OP_mem_size);
+            case cellsize_option::cs16: return ProduceInterpreterFor<short>(flags);
+            case cellsize_option::cs32: return ProduceInterpreterFor<int>(flags);
+            case cellsize_option::csu8: return ProduceInterpreterFor<unsigned char>(flags);
+            case cellsize_option::csu16: return ProduceInterpreterFor<unsigned short>(flags);
+            case cellsize_option::csu32: return ProduceInterpreterFor<unsigned int>(flags);
+            case cellsize_option::cs8:
+            default: return ProduceInterpreterFor<char>(flags);
+        }
+    }
+
+    //cells are evaluated in the selected size, so the wrap around is the same as at run time
+    bool EvaluatePrefix(ParserBase& parser, const Settings& flags)
+    {
+        bool evaluated;
+        switch (flags.OP_cellsize)
+        {
+            case cellsize_option::cs16: evaluated = PrefixEvaluator<short>(flags.OP_mem_size).Evaluate(parser); break;
+            case cellsize_option::cs32: evaluated = PrefixEvaluator<int>(flags.OP_mem_size).Evaluate(parser); break;
+            case cellsize_option::csu8: evaluated = PrefixEvaluator<unsigned char>(flags.OP_mem_size).Evaluate(parser); break;
+            case cellsize_option::csu16: evaluated = PrefixEvaluator<unsigned short>(flags.OP_mem_size).Evaluate(parser); break;
+            case cellsize_option::csu32: evaluated = PrefixEvaluator<unsigned int>(flags.OP_mem_size).Evaluate(parser); break;
+            case cellsize_option::cs8:
+            default: evaluated = PrefixEvaluator<char>(flags.OP_mem_size).Evaluate(parser); break;
         }
+
+        if (evaluated)
+            MessageLog::Instance().AddInfo("Partial evaluation: the start of the code was evaluated");
+        return evaluated;
+    }
+
+    void EmitC(const CodeTape& tape, const Settings& flags)
+    {
+        CodeGenerator generator(flags.OP_cellsize, flags.OP_mem_behavior, flags.OP_eof_behavior, flags.OP_mem_size);
+
+        if (flags.OP_emit_c_path == "-") {
+            generator.Generate(tape, std::cout);
+            return;
+        }
+
+        std::ofstream out(flags.OP_emit_c_path);
+        if (!out) {
+            MessageLog::Instance().AddMessage(MessageLog::ErrCode::ecArgumentError, "Cannot write file " + flags.OP_emit_c_path);
+            return;
+        }
+
+        generator.Generate(tape, out);
+        MessageLog::Instance().AddInfo("C code written to " + flags.OP_emit_c_path);
     }
 
     void RunAnalyser(ParserBase& parser, const Settings& flags)
@@ -105,7 +184,10 @@ namespace BT
                 if (flags.OP_analyse)
                 {
                     CodeAnalyser analyser(parser);
-                    flags.OP_optimize ? analyser.Repair() : analyser.Analyse();
+                    flags.OP_repair ? analyser.Repair() : analyser.Analyse();
+
+                    if (flags.OP_optimize)
+                        analyser.ResolveCalls();
 
                     if (analyser.isCodeValid())
                     {
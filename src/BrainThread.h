@@ -13,7 +13,11 @@ namespace BT {
 
     void RunAnalyser(ParserBase& parser, const Settings& flags);
 
+    bool EvaluatePrefix(ParserBase& parser, const Settings& flags);
+
     std::unique_ptr<InterpreterBase> ProduceInterpreter(const Settings& flags);
+
+    void EmitC(const CodeTape& tape, const Settings& flags);
 }
 
 
@@ -1,33 +1,71 @@
 #include <mutex>
+#include <algorithm>
 
 #include "BrainThreadProcess.h"
 #include "BrainThreadRuntimeException.h"
 #include "DebugLogStream.h"
 
 namespace BT {
+
+	template < typename T, mem_option M, eof_option E >
+	thread_local std::vector<typename BrainThreadProcess<T, M, E>::pending_fork> BrainThreadProcess<T, M, E>::pending_forks;
+
+	template < typename T, mem_option M, eof_option E >
+	thread_local unsigned int BrainThreadProcess<T, M, E>::inline_depth = 0;
 	
-	template < typename T >
-	BrainThreadProcess<T>::BrainThreadProcess(const CodeTape& ctape, unsigned int mem_size, mem_option mo, eof_option eo)
-		: isMain(true), code(ctape), memory(mem_size, eo, mo)
+	template < typename T, mem_option M, eof_option E >
+	BrainThreadProcess<T, M, E>::BrainThreadProcess(const CodeTape& ctape, unsigned int mem_size, engine_option en, schedule_policy sp)
+		: isMain(true), code(ctape), memory(mem_size), shared_heap(sp.blocking_heap), engine(en), policy(sp)
 	{
 		code_pointer = 0;
-		shared_heap = std::make_shared<MemoryHeap<T>>();
+		if (policy.blocking_heap)
+			running = std::make_shared<std::atomic<int>>(1);
 	}
 
-	template < typename T >
-	BrainThreadProcess<T>::BrainThreadProcess(const BrainThreadProcess<T>& parentProcess)
-		: isMain(false), code(parentProcess.code), memory(parentProcess.memory)
+	template < typename T, mem_option M, eof_option E >
+	BrainThreadProcess<T, M, E>::BrainThreadProcess(const BrainThreadProcess<T, M, E>& parentProcess)
+		: isMain(false), code(parentProcess.code), memory(parentProcess.memory), shared_heap(parentProcess.shared_heap), engine(parentProcess.engine), policy(parentProcess.policy)
 	{
 		code_pointer = parentProcess.code_pointer;
-		shared_heap = parentProcess.shared_heap;
+		threaded_code = parentProcess.threaded_code;
+
+		if (parentProcess.running) {
+			running = std::make_shared<std::atomic<int>>(1);
+			parent_running = parentProcess.running;
+			parent_running->fetch_add(1);
+		}
+	}
+
+	//the tape and the heaps change owners, nothing is copied
+	template < typename T, mem_option M, eof_option E >
+	BrainThreadProcess<T, M, E>::BrainThreadProcess(BrainThreadProcess<T, M, E>&& process)
+		: isMain(process.isMain), code(process.code), memory(std::move(process.memory)), heap(std::move(process.heap)), functions(std::move(process.functions)),
+		  shared_heap(std::move(process.shared_heap)), engine(process.engine), policy(process.policy), threaded_code(std::move(process.threaded_code)), child_threads(std::move(process.child_threads)), child_tasks(std::move(process.child_tasks))
+#ifdef BT_FIBERS
+		, child_fibers(std::move(process.child_fibers)), fiber_latch(std::move(process.fiber_latch))
+#endif
+	{
+		code_pointer = process.code_pointer;
+		running = std::move(process.running);
+		parent_running = std::move(process.parent_running);
+	}
+
+	//the last child to end brings its waiting parent back to the users of the shared heap
+	template < typename T, mem_option M, eof_option E >
+	BrainThreadProcess<T, M, E>::~BrainThreadProcess()
+	{
+		if (parent_running && parent_running->fetch_sub(1) == 1)
+			shared_heap.Enter();
 	}
 
-	template < typename T >
-	void BrainThreadProcess<T>::Run()
+	template < typename T, mem_option M, eof_option E >
+	void BrainThreadProcess<T, M, E>::Run()
 	{
 		try {
-			ExecInstructions();
-			Join();
+			if (engine == engine_option::enThreaded)
+				ExecThreadedInstructions();
+			else
+				ExecInstructions();
 		}
 		catch (const BrainThreadRuntimeException& re) {
 			std::cerr << "<t" << std::this_thread::get_id() << "> " << re.what() << std::endl;
@@ -38,12 +76,20 @@ namespace BT {
 		catch (...)	{
 			std::cerr << "<t" << std::this_thread::get_id() << "> FATAL ERROR" << std::endl;
 		}
+
+		//also after an error, the children must not outlive the process
+		try {
+			Join();
+		}
+		catch (...) {
+		}
 	}
 
-	template < typename T >
-	void BrainThreadProcess<T>::ExecInstructions(void)
+	template < typename T, mem_option M, eof_option E >
+	void BrainThreadProcess<T, M, E>::ExecInstructions(void)
 	{
-		std::mutex _mutex;
+		unsigned int quantum_left = policy.quantum;
+		unsigned int unchecked_end = 0; //] of the loop whose cells were checked on entry, moves before it are not checked
 		while (true)
 		{
 			const bt_instruction & current_instruction = code[this->code_pointer];
@@ -63,37 +109,53 @@ namespace BT {
 				memory.MoveRight();
 				break;
 			case bt_operation::btoOPT_Increment:
-				memory.Increment(current_instruction.repetitions);
+				memory.Increment(current_instruction.repetitions, current_instruction.offset);
 				break;
 			case bt_operation::btoOPT_Decrement:
-				memory.Decrement(current_instruction.repetitions);
+				memory.Decrement(current_instruction.repetitions, current_instruction.offset);
 				break;
 			case bt_operation::btoOPT_MoveLeft:
-				memory.MoveLeft(current_instruction.repetitions);
+				if (code_pointer < unchecked_end)
+					memory.Shift(-current_instruction.repetitions);
+				else
+					memory.MoveLeft(current_instruction.repetitions);
 				break;
 			case bt_operation::btoOPT_MoveRight:
-				memory.MoveRight(current_instruction.repetitions);
+				if (code_pointer < unchecked_end)
+					memory.Shift(current_instruction.repetitions);
+				else
+					memory.MoveRight(current_instruction.repetitions);
 				break;
 			case bt_operation::btoAsciiWrite:
-				memory.Write();
+				memory.Write(current_instruction.offset);
 				break;
 			case bt_operation::btoAsciiRead:
-				memory.Read();
+				if (!pending_forks.empty())
+					StartPending(); //the read may block
+				memory.Read(current_instruction.offset);
 				break;
 			case bt_operation::btoDecimalWrite:
-				memory.DecimalWrite();
+				memory.DecimalWrite(current_instruction.offset);
 				break;
 			case bt_operation::btoDecimalRead:
-				memory.DecimalRead();
+				if (!pending_forks.empty())
+					StartPending();
+				memory.DecimalRead(current_instruction.offset);
 				break;
 			case bt_operation::btoBeginLoop:
 				if (*(this->memory.GetValue()) == 0){
 					code_pointer = current_instruction.jump;
 				}
+				else if (code_pointer >= unchecked_end && current_instruction.repetitions &&
+					memory.InRange(-code[current_instruction.jump].repetitions, current_instruction.repetitions)) {
+					unchecked_end = current_instruction.jump;
+				}
 				break;
 			case bt_operation::btoEndLoop:
 				if (*(this->memory.GetValue()) != 0){
 					code_pointer = current_instruction.jump;
+					if (policy.at_back_edges)
+						Yield();
 				}
 				break;
 			case bt_operation::btoBeginFunction:
@@ -104,8 +166,17 @@ namespace BT {
 				if (this->functions.Return(&code_pointer) == false && isMain == false)//terminate threads spawned within function
 					return;
 				break;
+			case bt_operation::btoOPT_CallFunction:
+				if (code[code_pointer + 1].operation == bt_operation::btoEndFunction) //tail call
+					this->functions.TailEnter(*(this->memory.GetValue()), current_instruction.jump, &code_pointer);
+				else
+					this->functions.Enter(*(this->memory.GetValue()), current_instruction.jump, &code_pointer);
+				break;
 			case bt_operation::btoCallFunction:
-				this->functions.Call(*(this->memory.GetValue()), &code_pointer);
+				if (code[code_pointer + 1].operation == bt_operation::btoEndFunction) //tail call
+					this->functions.TailCall(*(this->memory.GetValue()), &code_pointer);
+				else
+					this->functions.Call(*(this->memory.GetValue()), &code_pointer);
 				--code_pointer; //bo na ko�cu p�tli jest ++
 				break;
 			case bt_operation::btoFork:
@@ -125,73 +196,49 @@ namespace BT {
 			case bt_operation::btoSwap:
 				this->heap.Swap();
 				break;
+			case bt_operation::btoOPT_PushRun:
+				this->heap.PushRun(memory, current_instruction.offset);
+				break;
+			case bt_operation::btoOPT_PopRun:
+				this->heap.PopRun(memory, current_instruction.offset);
+				break;
 			case bt_operation::btoSharedPush:
-				{
-					const std::lock_guard<std::mutex> lock(_mutex);
-					shared_heap->Push(*(this->memory.GetValue()));
-				}
+				shared_heap.Push(*(this->memory.GetValue()));
 				break;
 			case bt_operation::btoSharedPop:
-				{
-					const std::lock_guard<std::mutex> lock(_mutex);
-					*(this->memory.GetValue()) = shared_heap->Pop();
-				}
+				*(this->memory.GetValue()) = SharedPop();
 				break;
 			case bt_operation::btoSharedSwap:
-				{
-					const std::lock_guard<std::mutex> lock(_mutex);
-					shared_heap->Swap();
-				}
+				shared_heap.Swap();
 				break;
 
 				/**debug instructions
 				**/
 			case bt_operation::btoDEBUG_SimpleMemoryDump:
-				{
-					const std::lock_guard<std::mutex> lock(_mutex);
-					memory.SimpleMemoryDump(DebugLogStream::Instance().GetStream());
-				}
-				break;
 			case bt_operation::btoDEBUG_MemoryDump:
-				{
-					const std::lock_guard<std::mutex> lock(_mutex);
-					memory.MemoryDump(DebugLogStream::Instance().GetStream());
-				}
-				break;
 			case bt_operation::btoDEBUG_StackDump:
-				{
-					const std::lock_guard<std::mutex> lock(_mutex);
-					heap.PrintStack(DebugLogStream::Instance().GetStream());
-				}
-				break;
 			case bt_operation::btoDEBUG_SharedStackDump:
-				{
-					const std::lock_guard<std::mutex> lock(_mutex);
-					shared_heap->PrintStack(DebugLogStream::Instance().GetStream());
-				}	
-				break;
 			case bt_operation::btoDEBUG_FunctionsStackDump:
-				{
-					const std::lock_guard<std::mutex> lock(_mutex);
-					functions.PrintStackTrace(DebugLogStream::Instance().GetStream());
-				}
-				break;
 			case bt_operation::btoDEBUG_FunctionsDefsDump:
-				{
-					const std::lock_guard<std::mutex> lock(_mutex);
-					functions.PrintDeclaredFunctions(DebugLogStream::Instance().GetStream());
-				}
-				break;
 			case bt_operation::btoDEBUG_ThreadInfoDump:
-				{
-					const std::lock_guard<std::mutex> lock(_mutex);
-					PrintProcessInfo(DebugLogStream::Instance().GetStream());
-				}
+				DebugDump(current_instruction.operation);
 				break;
 
 				// Optimizer
 			case bt_operation::btoOPT_SetCellToZero:
-				*(this->memory.GetValue()) = 0;
+				*(current_instruction.offset ? memory.Reach(current_instruction.offset) : memory.GetValue()) = 0;
+				break;
+			case bt_operation::btoOPT_MulAdd:
+				this->memory.MulAdd(current_instruction.offset, current_instruction.repetitions);
+				break;
+			case bt_operation::btoOPT_MulSub:
+				this->memory.MulAdd(current_instruction.offset, -current_instruction.repetitions);
+				break;
+			case bt_operation::btoOPT_ScanRight:
+				this->memory.ScanRight(current_instruction.repetitions);
+				break;
+			case bt_operation::btoOPT_ScanLeft:
+				this->memory.ScanLeft(current_instruction.repetitions);
 				break;
 
 			case bt_operation::btoOPT_NoOperation:
@@ -205,24 +252,428 @@ namespace BT {
 			}
 
 			++code_pointer;
-			std::this_thread::yield(); // reszta czasu dla innych w�tk�w
+			if (policy.quantum && --quantum_left == 0) {
+				quantum_left = policy.quantum;
+				Yield(); // reszta czasu dla innych w�tk�w
+			}
+		}
+	}
+
+	/*
+	 * Threaded engine. Executes the same code as ExecInstructions, but the tape is
+	 * first translated to a stream of handler addresses, so every handler jumps
+	 * straight to the next one (no central switch). The cell pointer and the
+	 * instruction pointer live in locals and are written back to the process
+	 * only before calls which need them (I/O, functions, threads, slow moves).
+	*/
+#ifdef BT_COMPUTED_GOTO
+	#define BT_TARGET(op) L_##op:
+	#define BT_HANDLER(op) &&L_##op
+	#define BT_DISPATCH() goto *ip->handler
+#else
+	#define BT_TARGET(op) case bt_operation::op:
+	#define BT_HANDLER(op) bt_operation::op
+	#define BT_DISPATCH() goto dispatch
+#endif
+	#define BT_MAP(op) case bt_operation::op: tins.handler = BT_HANDLER(op); break;
+	#define BT_MAP_OFFSET(op) case bt_operation::op: tins.handler = BT_HANDLER(op); tins.jump = static_cast<unsigned int>(ins.offset); break;
+	#define BT_JUMP() if (quantum && --quantum_left == 0) { quantum_left = quantum; Yield(); } BT_DISPATCH()
+	#define BT_NEXT() ++ip; BT_JUMP()
+	#define BT_SYNC() memory.pointer = p; code_pointer = static_cast<unsigned int>(ip - base)
+	#define BT_RELOAD() p = memory.pointer; lo = memory.mem; hi = memory.max_mem
+	#define BT_CELL(c) T* c = p + static_cast<int>(ip->jump); \
+		if (c < lo || c > hi) { BT_SYNC(); c = memory.Reach(static_cast<int>(ip->jump)); BT_RELOAD(); }
+
+	template < typename T, mem_option M, eof_option E >
+	void BrainThreadProcess<T, M, E>::ExecThreadedInstructions(void)
+	{
+		if (!threaded_code) //translate once, children get the same stream
+		{
+			auto tcode = std::make_shared<ThreadedCode>();
+			tcode->reserve(code.size());
+
+			for (const bt_instruction& ins : code)
+			{
+				threaded_instruction tins{ BT_HANDLER(btoEndProgram), ins.repetitions, ins.jump };
+
+				switch (ins.operation)
+				{
+					BT_MAP(btoIncrement)
+					BT_MAP(btoDecrement)
+					BT_MAP(btoMoveLeft)
+					BT_MAP(btoMoveRight)
+					BT_MAP_OFFSET(btoOPT_Increment)
+					BT_MAP_OFFSET(btoOPT_Decrement)
+					BT_MAP(btoOPT_MoveLeft)
+					BT_MAP(btoOPT_MoveRight)
+					BT_MAP_OFFSET(btoAsciiRead)
+					BT_MAP_OFFSET(btoAsciiWrite)
+					BT_MAP_OFFSET(btoDecimalRead)
+					BT_MAP_OFFSET(btoDecimalWrite)
+					BT_MAP(btoEndFunction)
+					BT_MAP(btoFork)
+					BT_MAP(btoJoin)
+					BT_MAP(btoPush)
+					BT_MAP(btoPop)
+					BT_MAP(btoSwap)
+					BT_MAP(btoSharedPush)
+					BT_MAP(btoSharedPop)
+					BT_MAP(btoSharedSwap)
+					BT_MAP_OFFSET(btoOPT_SetCellToZero)
+					BT_MAP(btoOPT_ScanRight)
+					BT_MAP(btoOPT_ScanLeft)
+					BT_MAP_OFFSET(btoOPT_PushRun)
+					BT_MAP_OFFSET(btoOPT_PopRun)
+					case bt_operation::btoBeginLoop:
+						tins.handler = BT_HANDLER(btoBeginLoop);
+						tins.jump = ins.jump + 1;
+						break;
+					case bt_operation::btoEndLoop:
+						tins.handler = BT_HANDLER(btoEndLoop);
+						tins.jump = ins.jump + 1;
+						break;
+					case bt_operation::btoBeginFunction:
+						tins.handler = BT_HANDLER(btoBeginFunction);
+						tins.jump = ins.jump + 1;
+						break;
+					case bt_operation::btoCallFunction: //operand - tail call, the next one ends the function
+						tins.handler = BT_HANDLER(btoCallFunction);
+						tins.operand = (&ins)[1].operation == bt_operation::btoEndFunction;
+						break;
+					case bt_operation::btoOPT_CallFunction:
+						tins.handler = BT_HANDLER(btoOPT_CallFunction);
+						tins.operand = (&ins)[1].operation == bt_operation::btoEndFunction;
+						tins.jump = ins.jump + 1;
+						break;
+					case bt_operation::btoOPT_MulAdd:
+					case bt_operation::btoOPT_MulSub: //operand is the factor, jump the offset
+						tins.handler = BT_HANDLER(btoOPT_MulAdd);
+						tins.operand = ins.operation == bt_operation::btoOPT_MulAdd ? ins.repetitions : 0u - ins.repetitions;
+						tins.jump = static_cast<unsigned int>(ins.offset);
+						break;
+					case bt_operation::btoOPT_NoOperation:
+					case bt_operation::btoSwitchHeap:
+						tins.handler = BT_HANDLER(btoOPT_NoOperation);
+						break;
+					case bt_operation::btoDEBUG_SimpleMemoryDump:
+					case bt_operation::btoDEBUG_MemoryDump:
+					case bt_operation::btoDEBUG_StackDump:
+					case bt_operation::btoDEBUG_SharedStackDump:
+					case bt_operation::btoDEBUG_FunctionsStackDump:
+					case bt_operation::btoDEBUG_FunctionsDefsDump:
+					case bt_operation::btoDEBUG_ThreadInfoDump:
+						tins.handler = BT_HANDLER(btoDEBUG_Pragma);
+						tins.operand = static_cast<unsigned int>(ins.operation);
+						break;
+					default:
+						break;
+				}
+				tcode->push_back(tins);
+			}
+			threaded_code = tcode;
+		}
+
+		const unsigned int quantum = policy.quantum;
+		const bool back_edges = policy.at_back_edges;
+		unsigned int quantum_left = quantum;
+
+		const threaded_instruction* const base = threaded_code->data();
+		const threaded_instruction* ip = base + code_pointer;
+		T* p = memory.pointer;
+		T* lo = memory.mem;
+		T* hi = memory.max_mem;
+
+#ifdef BT_COMPUTED_GOTO
+		BT_DISPATCH();
+#else
+	dispatch:
+		switch (ip->handler)
+		{
+#endif
+		BT_TARGET(btoIncrement)
+			++(*p);
+			BT_NEXT();
+		BT_TARGET(btoDecrement)
+			--(*p);
+			BT_NEXT();
+		BT_TARGET(btoOPT_Increment)
+			{
+				BT_CELL(c);
+				(*c) += ip->operand;
+			}
+			BT_NEXT();
+		BT_TARGET(btoOPT_Decrement)
+			{
+				BT_CELL(c);
+				(*c) -= ip->operand;
+			}
+			BT_NEXT();
+		BT_TARGET(btoMoveRight)
+			if (p < hi) {
+				++p;
+			}
+			else {
+				BT_SYNC();
+				memory.MoveRight();
+				BT_RELOAD();
+			}
+			BT_NEXT();
+		BT_TARGET(btoMoveLeft)
+			if (p > lo) {
+				--p;
+			}
+			else {
+				BT_SYNC();
+				memory.MoveLeft();
+				BT_RELOAD();
+			}
+			BT_NEXT();
+		BT_TARGET(btoOPT_MoveRight)
+			if (static_cast<unsigned int>(hi - p) >= ip->operand) {
+				p += ip->operand;
+			}
+			else {
+				BT_SYNC();
+				memory.MoveRight(ip->operand);
+				BT_RELOAD();
+			}
+			BT_NEXT();
+		BT_TARGET(btoOPT_MoveLeft)
+			if (static_cast<unsigned int>(p - lo) >= ip->operand) {
+				p -= ip->operand;
+			}
+			else {
+				BT_SYNC();
+				memory.MoveLeft(ip->operand);
+				BT_RELOAD();
+			}
+			BT_NEXT();
+		BT_TARGET(btoOPT_SetCellToZero)
+			{
+				BT_CELL(c);
+				*c = 0;
+			}
+			BT_NEXT();
+		BT_TARGET(btoOPT_MulAdd)
+			if (*p != 0) {
+				const int offset = static_cast<int>(ip->jump);
+				if (offset > 0 ? hi - p >= offset : p - lo >= -offset) {
+					p[offset] = static_cast<T>(static_cast<unsigned int>(p[offset]) + static_cast<unsigned int>(*p) * ip->operand);
+				}
+				else {
+					BT_SYNC();
+					memory.MulAdd(offset, static_cast<int>(ip->operand));
+					BT_RELOAD();
+				}
+			}
+			BT_NEXT();
+		BT_TARGET(btoOPT_ScanRight)
+			BT_SYNC();
+			memory.ScanRight(ip->operand);
+			BT_RELOAD();
+			BT_NEXT();
+		BT_TARGET(btoOPT_ScanLeft)
+			BT_SYNC();
+			memory.ScanLeft(ip->operand);
+			BT_RELOAD();
+			BT_NEXT();
+		BT_TARGET(btoBeginLoop)
+			if (*p == 0) {
+				ip = base + ip->jump;
+				BT_JUMP();
+			}
+			BT_NEXT();
+		BT_TARGET(btoEndLoop)
+			if (*p != 0) {
+				ip = base + ip->jump;
+				if (back_edges)
+					Yield();
+				BT_JUMP();
+			}
+			BT_NEXT();
+		BT_TARGET(btoAsciiWrite)
+			BT_SYNC();
+			memory.Write(static_cast<int>(ip->jump));
+			BT_NEXT();
+		BT_TARGET(btoAsciiRead)
+			BT_SYNC();
+			if (!pending_forks.empty())
+				StartPending(); //the read may block
+			memory.Read(static_cast<int>(ip->jump));
+			BT_NEXT();
+		BT_TARGET(btoDecimalWrite)
+			BT_SYNC();
+			memory.DecimalWrite(static_cast<int>(ip->jump));
+			BT_NEXT();
+		BT_TARGET(btoDecimalRead)
+			BT_SYNC();
+			if (!pending_forks.empty())
+				StartPending();
+			memory.DecimalRead(static_cast<int>(ip->jump));
+			BT_NEXT();
+		BT_TARGET(btoBeginFunction)
+			BT_SYNC();
+			this->functions.Add(*p, code_pointer);
+			ip = base + ip->jump;
+			BT_JUMP();
+		BT_TARGET(btoEndFunction)
+			BT_SYNC();
+			if (this->functions.Return(&code_pointer) == false && isMain == false) //terminate threads spawned within function
+				return;
+			ip = base + code_pointer;
+			BT_NEXT();
+		BT_TARGET(btoCallFunction)
+			BT_SYNC();
+			if (ip->operand)
+				this->functions.TailCall(*p, &code_pointer);
+			else
+				this->functions.Call(*p, &code_pointer);
+			ip = base + code_pointer;
+			BT_JUMP();
+		BT_TARGET(btoOPT_CallFunction)
+			BT_SYNC();
+			if (ip->operand)
+				this->functions.TailEnter(*p, ip->jump, &code_pointer);
+			else
+				this->functions.Enter(*p, ip->jump, &code_pointer);
+			ip = base + code_pointer;
+			BT_JUMP();
+		BT_TARGET(btoFork)
+			BT_SYNC();
+			this->Fork();
+			BT_NEXT();
+		BT_TARGET(btoJoin)
+			this->Join();
+			BT_NEXT();
+		BT_TARGET(btoPush)
+			this->heap.Push(*p);
+			BT_NEXT();
+		BT_TARGET(btoPop)
+			*p = this->heap.Pop();
+			BT_NEXT();
+		BT_TARGET(btoSwap)
+			this->heap.Swap();
+			BT_NEXT();
+		BT_TARGET(btoOPT_PushRun)
+			BT_SYNC();
+			this->heap.PushRun(memory, static_cast<int>(ip->jump));
+			BT_RELOAD();
+			BT_NEXT();
+		BT_TARGET(btoOPT_PopRun)
+			BT_SYNC();
+			this->heap.PopRun(memory, static_cast<int>(ip->jump));
+			BT_RELOAD();
+			BT_NEXT();
+		BT_TARGET(btoSharedPush)
+			shared_heap.Push(*p);
+			BT_NEXT();
+		BT_TARGET(btoSharedPop)
+			*p = SharedPop();
+			BT_NEXT();
+		BT_TARGET(btoSharedSwap)
+			shared_heap.Swap();
+			BT_NEXT();
+		BT_TARGET(btoDEBUG_Pragma) //all debug dumps, operation kept in operand
+			BT_SYNC();
+			DebugDump(static_cast<bt_operation>(ip->operand));
+			BT_NEXT();
+		BT_TARGET(btoOPT_NoOperation)
+			BT_NEXT();
+#ifndef BT_COMPUTED_GOTO
+		default:
+#endif
+		BT_TARGET(btoEndProgram)
+			BT_SYNC();
+			return;
+#ifndef BT_COMPUTED_GOTO
+		}
+#endif
+	}
+
+	#undef BT_TARGET
+	#undef BT_HANDLER
+	#undef BT_DISPATCH
+	#undef BT_MAP
+	#undef BT_MAP_OFFSET
+	#undef BT_CELL
+	#undef BT_JUMP
+	#undef BT_NEXT
+	#undef BT_SYNC
+	#undef BT_RELOAD
+
+	template < typename T, mem_option M, eof_option E >
+	void BrainThreadProcess<T, M, E>::DebugDump(bt_operation op)
+	{
+		static std::mutex _mutex;
+		const std::lock_guard<std::mutex> lock(_mutex);
+
+		switch (op)
+		{
+		case bt_operation::btoDEBUG_SimpleMemoryDump:
+			memory.SimpleMemoryDump(DebugLogStream::Instance().GetStream());
+			break;
+		case bt_operation::btoDEBUG_MemoryDump:
+			memory.MemoryDump(DebugLogStream::Instance().GetStream());
+			break;
+		case bt_operation::btoDEBUG_StackDump:
+			heap.PrintStack(DebugLogStream::Instance().GetStream());
+			break;
+		case bt_operation::btoDEBUG_SharedStackDump:
+			shared_heap.PrintStack(DebugLogStream::Instance().GetStream());
+			break;
+		case bt_operation::btoDEBUG_FunctionsStackDump:
+			functions.PrintStackTrace(DebugLogStream::Instance().GetStream());
+			break;
+		case bt_operation::btoDEBUG_FunctionsDefsDump:
+			functions.PrintDeclaredFunctions(DebugLogStream::Instance().GetStream());
+			break;
+		case bt_operation::btoDEBUG_ThreadInfoDump:
+			PrintProcessInfo(DebugLogStream::Instance().GetStream());
+			break;
+		default:
+			break;
 		}
 	}
 
-	template < typename T >
-	void BrainThreadProcess<T>::Fork()
+	template < typename T, mem_option M, eof_option E >
+	void BrainThreadProcess<T, M, E>::Fork()
 	{
 		try
 		{
-			BrainThreadProcess<T> child(*this);
+			//the only copy of the tape, the thread gets the process itself
+			std::unique_ptr<BrainThreadProcess<T, M, E>> child = std::make_unique<BrainThreadProcess<T, M, E>>(*this);
 
 			*(this->memory.GetValue()) = 0;
-			child.memory.MoveRight();
-			*(child.memory.GetValue()) = 1;
-			++child.code_pointer;
+			child->memory.MoveRight();
+			*(child->memory.GetValue()) = 1;
+			++child->code_pointer;
+
+#ifdef BT_FIBERS
+			if (policy.threads == thread_option::toFiber) {
+				if (!fiber_latch)
+					fiber_latch = std::make_unique<FiberScheduler::latch>();
+
+				child_fibers.push_back(std::make_unique<process_fiber>());
+				child_fibers.back()->process = std::move(child);
+				FiberScheduler::Instance().Spawn(child_fibers.back().get(), *fiber_latch);
+				return;
+			}
+#endif
+			if (policy.threads == thread_option::toPool) {
+				std::shared_ptr<process_task> task = std::make_shared<process_task>();
+				task->process = std::move(child);
+				child_tasks.push_back(task);
+				WorkPool::Instance().Submit(std::move(task));
+				return;
+			}
 
-			child_threads.emplace_back([](BrainThreadProcess<T> process) {
-				process.Run();
+			if (inline_depth < inline_limit) {
+				pending_forks.push_back({ std::move(child), this });
+				return;
+			}
+
+			child_threads.emplace_back([](std::unique_ptr<BrainThreadProcess<T, M, E>> process) {
+				process->Run();
 			}, std::move(child));
 		}
 		catch (const BFRangeException& re)
@@ -245,18 +696,135 @@ namespace BT {
 		}
 	}
 
-	template < typename T >
-	void BrainThreadProcess<T>::Join(void)
+	template < typename T, mem_option M, eof_option E >
+	void BrainThreadProcess<T, M, E>::Join(void)
 	{
+		//the process pushes nothing until its children end
+		if (running && running->fetch_sub(1) != 1)
+			shared_heap.Leave();
+
+		RunPending();
+
 		for (std::thread& t : child_threads) {
 			if(t.joinable())
 				t.join();
 		}
 		child_threads.clear();
+
+		for (const std::shared_ptr<process_task>& task : child_tasks)
+			WorkPool::Instance().Wait(*task);
+		child_tasks.clear();
+
+#ifdef BT_FIBERS
+		if (fiber_latch)
+			FiberScheduler::Instance().Join(*fiber_latch);
+		child_fibers.clear();
+#endif
+
+		if (running)
+			running->store(1);
 	}
 
-	template < typename T >
-	void BrainThreadProcess<T>::PrintProcessInfo(std::ostream& s)
+	//rest of the time slice for the other threads, a fiber gives its carrier to the next one
+	template < typename T, mem_option M, eof_option E >
+	void BrainThreadProcess<T, M, E>::Yield(void)
+	{
+#ifdef BT_FIBERS
+		if (policy.threads == thread_option::toFiber) {
+			FiberScheduler::Yield();
+			return;
+		}
+#endif
+		if (!pending_forks.empty())
+			StartPending();
+		std::this_thread::yield();
+	}
+
+	/*
+	 * The process goes on working, so its forks - and the forks of the processes run in place
+	 * below it on this thread - get their threads now. A fork for which no thread can be made
+	 * stays pending and runs in place when joined.
+	*/
+	template < typename T, mem_option M, eof_option E >
+	void BrainThreadProcess<T, M, E>::StartPending(void)
+	{
+		size_t started = 0;
+		for (pending_fork& f : pending_forks)
+		{
+			BrainThreadProcess<T, M, E>* const process = f.process.get();
+			try {
+				f.parent->child_threads.emplace_back([process]() {
+					std::unique_ptr<BrainThreadProcess<T, M, E>> owned(process);
+					owned->Run();
+				});
+			}
+			catch (const std::system_error&) {
+				break;
+			}
+			f.process.release();
+			++started;
+		}
+		pending_forks.erase(pending_forks.begin(), pending_forks.begin() + started);
+	}
+
+	//an empty blocking heap waits for a push, a pool worker runs other tasks meanwhile
+	template < typename T, mem_option M, eof_option E >
+	T BrainThreadProcess<T, M, E>::SharedPop(void)
+	{
+		T value;
+		while (!shared_heap.TryPop(value))
+		{
+			if (!policy.blocking_heap)
+				return 0;
+
+			if (!pending_forks.empty())
+				StartPending(); //they may be the ones to push
+			if (policy.threads == thread_option::toPool)
+				shared_heap.Wait([]() { return WorkPool::Instance().Help(); });
+			else
+				shared_heap.Wait(nullptr);
+		}
+		return value;
+	}
+
+	//forks nobody has started yet run on the joining thread in the order they were made
+	template < typename T, mem_option M, eof_option E >
+	void BrainThreadProcess<T, M, E>::RunPending(void)
+	{
+		while (true)
+		{
+			typename std::vector<pending_fork>::iterator it = std::find_if(pending_forks.begin(), pending_forks.end(), [this](const pending_fork& f) { return f.parent == this; });
+			if (it == pending_forks.end())
+				return;
+
+			std::unique_ptr<BrainThreadProcess<T, M, E>> process = std::move(it->process);
+			pending_forks.erase(it);
+
+			++inline_depth;
+			process->Run();
+			--inline_depth;
+		}
+	}
+
+	//the tape goes away as soon as the thread ends
+	template < typename T, mem_option M, eof_option E >
+	void BrainThreadProcess<T, M, E>::process_task::Run()
+	{
+		process->Run();
+		process.reset();
+	}
+
+#ifdef BT_FIBERS
+	template < typename T, mem_option M, eof_option E >
+	void BrainThreadProcess<T, M, E>::process_fiber::Run()
+	{
+		process->Run();
+		process.reset();
+	}
+#endif
+
+	template < typename T, mem_option M, eof_option E >
+	void BrainThreadProcess<T, M, E>::PrintProcessInfo(std::ostream& s)
 	{
 		int i = 0;
 		s << "\n>Current thread id: " << std::this_thread::get_id() << " ";
@@ -264,6 +832,21 @@ namespace BT {
 		if (isMain)
 			s << "(main)";  
 
+		if (!child_tasks.empty()) {
+			s << "\nChild tasks: " << child_tasks.size() << ", finished: "
+			  << std::count_if(child_tasks.begin(), child_tasks.end(), [](const std::shared_ptr<process_task>& task) { return task->done.load(); })
+			  << ", workers: " << WorkPool::Instance().Workers();
+		}
+
+#ifdef BT_FIBERS
+		if (!child_fibers.empty())
+			s << "\nChild fibers: " << child_fibers.size() << ", carriers: " << FiberScheduler::Instance().Carriers();
+#endif
+
+		const std::ptrdiff_t pending = std::count_if(pending_forks.begin(), pending_forks.end(), [this](const pending_fork& f) { return f.parent == this; });
+		if (pending)
+			s << "\nPending forks: " << pending;
+
 		if (child_threads.size() == 0) {
 			s << std::endl;
 			return;
@@ -282,11 +865,10 @@ namespace BT {
 
 
 	// Explicit template instantiation
-	
-	template class BrainThreadProcess<char>;
-	template class BrainThreadProcess<unsigned char>;
-	template class BrainThreadProcess<unsigned short>;
-	template class BrainThreadProcess<unsigned int>;
-	template class BrainThreadProcess<short>;
-	template class BrainThreadProcess<int>;
+	BT_INSTANTIATE_BEHAVIORS(BrainThreadProcess, char)
+	BT_INSTANTIATE_BEHAVIORS(BrainThreadProcess, unsigned char)
+	BT_INSTANTIATE_BEHAVIORS(BrainThreadProcess, unsigned short)
+	BT_INSTANTIATE_BEHAVIORS(BrainThreadProcess, unsigned int)
+	BT_INSTANTIATE_BEHAVIORS(BrainThreadProcess, short)
+	BT_INSTANTIATE_BEHAVIORS(BrainThreadProcess, int)
 }
\ No newline at end of file
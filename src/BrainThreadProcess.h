@@ -1,41 +1,124 @@
 #pragma once
 
 #include <list>
+#include <atomic>
 #include <thread>
 #include <memory>
 
 #include "MemoryTape.h"
 #include "MemoryHeap.h"
+#include "SharedHeap.h"
 #include "FunctionHeap.h"
 #include "CodeTape.h"
+#include "WorkPool.h"
+#include "FiberScheduler.h"
+
+#if defined(__GNUC__) || defined(__clang__)
+	#define BT_COMPUTED_GOTO
+#endif
 
 namespace BT {
 
-	template < typename T >
+	/*
+	 * Instruction of the threaded engine. The code tape is translated once
+	 * into a stream of handler addresses (labels as values on GCC/Clang,
+	 * plain operations for the portable switch) with the jump targets resolved.
+	*/
+	struct threaded_instruction
+	{
+#ifdef BT_COMPUTED_GOTO
+		const void* handler;
+#else
+		bt_operation handler;
+#endif
+		unsigned int operand;
+		unsigned int jump;
+	};
+
+	typedef std::vector<threaded_instruction> ThreadedCode;
+
+	/*
+	 * When a thread gives the rest of its time slice to the other threads.
+	 * Code without forks runs alone, so it does not yield at all.
+	*/
+	struct schedule_policy
+	{
+		unsigned int quantum = 0; //instructions executed between yields, 0 - no quantum
+		bool at_back_edges = false; //yield when a loop jumps back
+		thread_option threads = thread_option::toSystem; //what runs the forks
+		bool blocking_heap = false; //~^ on an empty shared heap waits for a push
+	};
+
+	template < typename T, mem_option M, eof_option E >
 	class BrainThreadProcess
 	{
 	public:
-		BrainThreadProcess(const CodeTape& c, unsigned int mem_size, mem_option mo, eof_option eo);
-		BrainThreadProcess(const BrainThreadProcess<T>& parentProcess);
+		BrainThreadProcess(const CodeTape& c, unsigned int mem_size, engine_option en, schedule_policy sp);
+		BrainThreadProcess(const BrainThreadProcess<T, M, E>& parentProcess);
+		BrainThreadProcess(BrainThreadProcess<T, M, E>&& process);
+		~BrainThreadProcess(void);
 
 		void Run(void);
 		
 		void PrintProcessInfo(std::ostream& s);
 
 	private:
-		MemoryTape<T> memory;
+		MemoryTape<T, M, E> memory;
 		MemoryHeap<T> heap;
 		FunctionHeap<T> functions;
 		
-		std::shared_ptr<MemoryHeap<T>> shared_heap;
+		SharedHeap<T> shared_heap; //every process has its own handle to the same cells
 		const CodeTape& code;
 		unsigned int code_pointer;
 
+		const engine_option engine;
+		const schedule_policy policy;
+		std::shared_ptr<const ThreadedCode> threaded_code; //shared with forked children
+
+		//blocking heap: children which have not ended, plus one while the process does not wait for them
+		std::shared_ptr<std::atomic<int>> running;
+		std::shared_ptr<std::atomic<int>> parent_running;
+
 		std::list<std::thread> child_threads;
 
+		//fork which gets a system thread only if its parent goes on working, a join runs it in place
+		struct pending_fork
+		{
+			std::unique_ptr<BrainThreadProcess<T, M, E>> process;
+			BrainThreadProcess<T, M, E>* parent;
+		};
+		static thread_local std::vector<pending_fork> pending_forks; //of the processes on this thread, oldest first
+		static thread_local unsigned int inline_depth;
+		static constexpr unsigned int inline_limit = 64; //forks run inside each other, the stack has to hold them
+
+		//forked process run by the pool
+		struct process_task : WorkPool::task
+		{
+			std::unique_ptr<BrainThreadProcess<T, M, E>> process;
+			void Run(void) override;
+		};
+		std::list<std::shared_ptr<process_task>> child_tasks;
+
+#ifdef BT_FIBERS
+		//forked process run as a fiber
+		struct process_fiber : FiberScheduler::fiber
+		{
+			std::unique_ptr<BrainThreadProcess<T, M, E>> process;
+			void Run(void) override;
+		};
+		std::list<std::unique_ptr<process_fiber>> child_fibers;
+		std::unique_ptr<FiberScheduler::latch> fiber_latch; //made with the first fiber
+#endif
+
 		void Fork(void);
 		void Join(void);
+		void Yield(void);
+		void StartPending(void);
+		void RunPending(void);
+		T SharedPop(void);
 		void ExecInstructions(void);
+		void ExecThreadedInstructions(void);
+		void DebugDump(bt_operation op);
 
 	private:
 		bool isMain;
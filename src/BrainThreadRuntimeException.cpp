@@ -1,4 +1,4 @@
 #include "BrainThreadRuntimeException.h"
 
-std::ostringstream BrainThreadRuntimeException::cnvt;
-std::string BrainThreadRuntimeException::s;
\ No newline at end of file
+thread_local std::ostringstream BrainThreadRuntimeException::cnvt;
+thread_local std::string BrainThreadRuntimeException::s;
\ No newline at end of file
@@ -28,8 +28,8 @@ public:
   }
 
 protected:
-    static std::ostringstream cnvt;
-	  static std::string s;
+    static thread_local std::ostringstream cnvt; //threads fail at once, e.g. in a deadlock
+	  static thread_local std::string s;
 };
 
 class BFAllocException: public BrainThreadRuntimeException {
@@ -201,6 +201,22 @@ protected:
     unsigned err_no;
 };
 
+class BFDeadlockException: public BrainThreadRuntimeException {
+public:
+
+  BFDeadlockException()
+    : BrainThreadRuntimeException()
+    {}
+
+  virtual const char* what() const throw()
+  {
+    cnvt.str( "" );
+	cnvt << BrainThreadRuntimeException::what() << "Deadlock, every thread waits for the shared heap or for its children.";
+    s = cnvt.str();
+    return s.c_str();
+  }
+};
+
 class BFInvalidInputStreamException: public BrainThreadRuntimeException {
 public:
 
@@ -56,7 +56,14 @@ namespace BT {
 			ins.operation == bt_operation::btoEndLoop ||
 			ins.operation == bt_operation::btoCallFunction ||
 			ins.operation == bt_operation::btoPop ||
-			ins.operation == bt_operation::btoSharedPop);
+			ins.operation == bt_operation::btoSharedPop ||
+			ins.operation == bt_operation::btoOPT_SetCellToZero ||
+			ins.operation == bt_operation::btoOPT_MulAdd ||
+			ins.operation == bt_operation::btoOPT_MulSub ||
+			ins.operation == bt_operation::btoOPT_ScanRight ||
+			ins.operation == bt_operation::btoOPT_ScanLeft ||
+			ins.operation == bt_operation::btoOPT_PushRun ||
+			ins.operation == bt_operation::btoOPT_PopRun);
 	}
 
 	//Operatory czone parami z innymi: ptle i funkcje
@@ -74,7 +81,23 @@ namespace BT {
 		return (IsArithmeticInstruction(ins) ||
 			ins.operation == bt_operation::btoPop ||
 			ins.operation == bt_operation::btoSharedPop ||
+			ins.operation == bt_operation::btoOPT_PopRun ||
 			ins.operation == bt_operation::btoAsciiRead ||
+			ins.operation == bt_operation::btoDecimalRead ||
+			ins.operation == bt_operation::btoOPT_SetCellToZero ||
+			ins.operation == bt_operation::btoOPT_MulAdd ||
+			ins.operation == bt_operation::btoOPT_MulSub);
+	}
+
+	//Operators addressing the cell at pointer + offset (level 2 code)
+	bool CodeAnalyser::IsOffsetInstruction(const bt_instruction& ins)
+	{
+		return (ins.operation == bt_operation::btoOPT_Increment ||
+			ins.operation == bt_operation::btoOPT_Decrement ||
+			ins.operation == bt_operation::btoOPT_SetCellToZero ||
+			ins.operation == bt_operation::btoAsciiWrite ||
+			ins.operation == bt_operation::btoAsciiRead ||
+			ins.operation == bt_operation::btoDecimalWrite ||
 			ins.operation == bt_operation::btoDecimalRead);
 	}
 
@@ -90,7 +113,8 @@ namespace BT {
 	bool inline CodeAnalyser::IsFlowChangingInstruction(const bt_instruction& ins)
 	{
 		return (IsLinkableInstruction(ins) ||
-			ins.operation == bt_operation::btoCallFunction);
+			ins.operation == bt_operation::btoCallFunction ||
+			ins.operation == bt_operation::btoOPT_CallFunction);
 	}
 
 
@@ -596,7 +620,8 @@ namespace BT {
 		if (IsArithmeticInstruction(*it))
 		{
 			ignore_arithmetic_test = true;
-			n = std::find_if_not(it, parser.instructions.end(), IsArithmeticInstruction);
+			//a run of + - on the same cell, level 2 code addresses cells by offset
+			n = std::find_if_not(it, parser.instructions.end(), [&it](const bt_instruction& o) { return IsArithmeticInstruction(o) && o.offset == it->offset; });
 			//mamy cig + - 
 			//instrukcji musi byc wicej niz jedna i wynik ma byc osignity najmniejsza liczba instrukcji, czyli bez np suma = 2 dla ++ [ops=2] a nie +-+-++ [ops=5]
 
@@ -770,6 +795,208 @@ namespace BT {
 		return opening_bracket_cnt > closing_bracket_cnt;
 	}
 
+	//A call on a cell with a known value goes straight to its function, if every function is
+	//defined on the top level with a known, unique identifier (so each definition runs once)
+	//and the definition comes before the call. Small functions are copied in place of the call.
+	void CodeAnalyser::ResolveCalls(void)
+	{
+		CodeGraph graph(parser.instructions);
+		std::vector<code_node>& nodes = graph.Nodes();
+
+		unsigned int functions = 0;
+		graph.ForEach([&functions](code_node& node) {
+			if (node.kind == node_kind::nkFunction)
+				++functions;
+		});
+		if (functions == 0)
+			return;
+
+		definition_map definitions;
+		known_cells cells;
+		cells.zero = true;
+		unsigned int code_position = 0;
+
+		for (size_t i = 0; i < nodes.size(); ++i)
+		{
+			if (nodes[i].kind == node_kind::nkFunction)
+			{
+				const int id = cells.Value(cells.position);
+				if (id < 0 || definitions.count(id) > 0)
+					return;
+				definitions[id] = std::make_pair(i, code_position);
+			}
+			TrackCells(nodes[i], cells);
+			code_position += CodeGraph::Size(nodes[i]);
+		}
+		if (definitions.size() != functions)
+			return;
+
+		resolved_calls = inlined_calls = 0;
+		ResolveCalls(nodes, nodes, definitions, 0);
+
+		if (resolved_calls + inlined_calls > 0)
+		{
+			parser.instructions = graph.Lower();
+			MessageLog::Instance().AddInfo("Code Analyser: " + std::to_string(resolved_calls) + " calls resolved, " +
+				std::to_string(inlined_calls) + " inlined");
+		}
+	}
+
+	//limit - definitions on the top level before this node have run
+	void CodeAnalyser::ResolveCalls(std::vector<code_node>& body, std::vector<code_node>& top, const definition_map& definitions, size_t limit)
+	{
+		const bool top_level = (&body == &top);
+		std::vector<std::pair<size_t, size_t>> inlines; //call node, function node; copied after the walk, so indexes hold
+		known_cells cells;
+		cells.zero = top_level;
+
+		for (size_t j = 0; j < body.size(); ++j)
+		{
+			code_node& node = body[j];
+			const size_t available = top_level ? j : limit;
+
+			if (node.kind == node_kind::nkCall && node.instructions.front().operation == bt_operation::btoCallFunction)
+			{
+				const int id = cells.Value(cells.position);
+				auto definition = (id < 0) ? definitions.end() : definitions.find(id);
+
+				if (definition != definitions.end() && definition->second.first < available)
+				{
+					unsigned int size = 0;
+					if (IsInlinable(top[definition->second.first].body, size) && size <= inline_limit) {
+						inlines.emplace_back(j, definition->second.first);
+						++inlined_calls;
+					}
+					else {
+						node.instructions.front() = bt_instruction(bt_operation::btoOPT_CallFunction, definition->second.second);
+						++resolved_calls;
+					}
+				}
+			}
+			else if (node.kind == node_kind::nkLoop || node.kind == node_kind::nkFunction)
+			{
+				ResolveCalls(node.body, top, definitions, available);
+			}
+
+			TrackCells(node, cells);
+		}
+
+		for (auto it = inlines.rbegin(); it != inlines.rend(); ++it)
+		{
+			std::vector<code_node> copy = top[it->second].body;
+			body.erase(body.begin() + it->first);
+			body.insert(body.begin() + it->first, copy.begin(), copy.end());
+		}
+	}
+
+	int CodeAnalyser::known_cells::Value(int cell) const
+	{
+		auto known = values.find(cell);
+		if (known != values.end())
+			return known->second;
+		return zero ? 0 : -1;
+	}
+
+	void CodeAnalyser::known_cells::Forget()
+	{
+		values.clear();
+		zero = false;
+	}
+
+	//only small values are kept, they are the same for every cell size
+	void CodeAnalyser::TrackCells(const code_node& node, known_cells& cells)
+	{
+		switch (node.kind)
+		{
+		case node_kind::nkFunction: //a definition changes nothing
+			return;
+		case node_kind::nkLoop: //ends on a zero cell
+			cells.Forget();
+			cells.values[cells.position] = 0;
+			return;
+		case node_kind::nkBlock:
+			break;
+		default:
+			cells.Forget();
+			return;
+		}
+
+		for (const bt_instruction& ins : node.instructions)
+		{
+			const int target = cells.position + ins.offset;
+			switch (ins.operation)
+			{
+			case bt_operation::btoMoveRight:
+			case bt_operation::btoOPT_MoveRight: cells.position += ins.repetitions; break;
+			case bt_operation::btoMoveLeft:
+			case bt_operation::btoOPT_MoveLeft: cells.position -= ins.repetitions; break;
+			case bt_operation::btoOPT_SetCellToZero: cells.values[target] = 0; break;
+			case bt_operation::btoIncrement:
+			case bt_operation::btoOPT_Increment:
+			case bt_operation::btoDecrement:
+			case bt_operation::btoOPT_Decrement:
+			{
+				int value = cells.Value(target);
+				if (value >= 0) {
+					value += (ins.operation == bt_operation::btoIncrement || ins.operation == bt_operation::btoOPT_Increment) ? ins.repetitions : -ins.repetitions;
+					if (value > SCHAR_MAX)
+						value = -1;
+				}
+				cells.values[target] = value;
+				break;
+			}
+			case bt_operation::btoOPT_MulAdd:
+			case bt_operation::btoOPT_MulSub:
+			case bt_operation::btoAsciiRead:
+			case bt_operation::btoDecimalRead:
+				cells.values[target] = -1;
+				break;
+			case bt_operation::btoOPT_ScanRight:
+			case bt_operation::btoOPT_ScanLeft:
+				cells.Forget();
+				cells.values[cells.position] = 0; //the position is lost, keep counting from the zero cell
+				break;
+			case bt_operation::btoOPT_PopRun:
+				for (int i = std::min(ins.offset, 0); i <= std::max(ins.offset, 0); ++i)
+					cells.values[cells.position + i] = -1;
+				cells.position += ins.offset;
+				break;
+			case bt_operation::btoOPT_PushRun:
+				cells.position += ins.offset;
+				break;
+			case bt_operation::btoAsciiWrite:
+			case bt_operation::btoDecimalWrite:
+			case bt_operation::btoPush:
+			case bt_operation::btoSharedPush:
+			case bt_operation::btoSwitchHeap:
+			case bt_operation::btoOPT_NoOperation:
+				break;
+			default:
+				cells.Forget();
+				break;
+			}
+		}
+	}
+
+	//no calls, definitions, threads or debug instructions, which would see the difference
+	bool CodeAnalyser::IsInlinable(const std::vector<code_node>& body, unsigned int& size)
+	{
+		for (const code_node& node : body)
+		{
+			if (node.kind == node_kind::nkFunction || node.kind == node_kind::nkCall || node.kind == node_kind::nkFork)
+				return false;
+
+			for (const bt_instruction& ins : node.instructions)
+				if (ins.operation >= bt_operation::btoDEBUG_SimpleMemoryDump)
+					return false;
+
+			size += static_cast<unsigned int>(node.instructions.size());
+			if (!IsInlinable(node.body, size))
+				return false;
+		}
+		return true;
+	}
+
 	//Funkcje modyfikuj linkowania 
 	void CodeAnalyser::RelinkCommands(const CodeTapeIterator& start, short n)
 	{
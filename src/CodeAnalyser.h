@@ -2,9 +2,11 @@
 
 #include "Parser.h"
 #include "MessageLog.h"
+#include "CodeGraph.h"
 
 #include <vector>
 #include <functional>
+#include <map>
 
 namespace BT {
 
@@ -27,6 +29,7 @@ namespace BT {
 
 		void Analyse();
 		void Repair();
+		void ResolveCalls();
 
 		bool isCodeValid(void);
 		bool RepairedSomething();
@@ -61,6 +64,29 @@ namespace BT {
 
 		bool TestLinks();
 
+		//identifier -> top level node and position of the definition
+		typedef std::map<int, std::pair<size_t, unsigned int>> definition_map;
+
+		//cells with a known value, relative to where the walk started; -1 - unknown
+		struct known_cells
+		{
+			std::map<int, int> values;
+			int position = 0;
+			bool zero = false; //cells not in values are zero (start of the program)
+
+			int Value(int cell) const;
+			void Forget();
+		};
+
+		void ResolveCalls(std::vector<code_node>& body, std::vector<code_node>& top, const definition_map& definitions, size_t limit);
+		static void TrackCells(const code_node& node, known_cells& cells);
+		static bool IsInlinable(const std::vector<code_node>& body, unsigned int& size);
+
+		static const unsigned int inline_limit = 32; //instructions
+
+		unsigned int resolved_calls;
+		unsigned int inlined_calls;
+
 		unsigned int function_calls;
 		unsigned int function_limit;
 		unsigned int function_def;
@@ -78,5 +104,6 @@ namespace BT {
 		static bool IsSharedHeapInstruction(const bt_instruction& op);
 		static bool IsFlowChangingInstruction(const bt_instruction& op);
 		static bool IsRepetitionOptimizableOperator(const bt_operation& op);
+		static bool IsOffsetInstruction(const bt_instruction& op);
 	};
 }
\ No newline at end of file
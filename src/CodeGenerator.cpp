@@ -0,0 +1,618 @@
+#include <sstream>
+
+#include "CodeGenerator.h"
+#include "CodeAnalyser.h"
+
+namespace BT {
+
+	//runtime support of the generated program, messages follow BrainThreadRuntimeException
+	static const char* c_runtime = R"(
+#define BT_STACK_LIMIT 65536u
+
+struct bt_proc;
+typedef void (*bt_fn)(struct bt_proc*, int);
+
+typedef struct bt_heap {
+	cell* data;
+	unsigned size, cap;
+} bt_heap;
+
+typedef struct bt_proc {
+	cell* mem;
+	cell* p;
+	unsigned len;
+	bt_heap heap;
+	ucell* fn_ids; /* function dispatch table, open addressing */
+	bt_fn* fn_ptrs;
+	unsigned fn_count, fn_cap, depth;
+	pthread_t* children;
+	unsigned child_count, child_cap;
+	bt_fn entry_fn;
+	bt_fn tail; /* called at the end of a function, run by its caller */
+	int entry, halt;
+} bt_proc;
+
+static bt_heap bt_shared_heap;
+static pthread_mutex_t bt_shared_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#define SYNC() (P->p = p)
+#define LOAD() (p = P->p)
+
+static void bt_error(bt_proc* P, const char* msg)
+{
+	fflush(stdout);
+	fprintf(stderr, "<t%lu> %s\n", (unsigned long)pthread_self(), msg);
+	P->halt = 1;
+}
+
+static void bt_range_error(bt_proc* P, unsigned pos)
+{
+	char msg[160];
+	snprintf(msg, sizeof(msg), "Runtime Exception: The pointer tried to reach a cell out of memory range. Pointer position: %u.", pos);
+	bt_error(P, msg);
+}
+
+static void bt_alloc_error(bt_proc* P, unsigned len)
+{
+	char msg[160];
+	snprintf(msg, sizeof(msg), "Runtime Exception: Cannot allocate %u cells of memory (%lu bytes).", len, (unsigned long)(len * sizeof(cell)));
+	bt_error(P, msg);
+}
+
+static bt_proc* bt_new_proc(unsigned len)
+{
+	bt_proc* P = (bt_proc*)calloc(1, sizeof(bt_proc));
+	if (P == NULL)
+		return NULL;
+	P->mem = (cell*)calloc(len, sizeof(cell));
+	if (P->mem == NULL) {
+		free(P);
+		return NULL;
+	}
+	P->len = len;
+	P->p = P->mem;
+	return P;
+}
+
+static void bt_free_proc(bt_proc* P)
+{
+	free(P->mem);
+	free(P->heap.data);
+	free(P->fn_ids);
+	free(P->fn_ptrs);
+	free(P->children);
+	free(P);
+}
+
+/* dynamic tape grows like MemoryTape::Realloc */
+static int bt_grow(bt_proc* P, unsigned long long need)
+{
+	unsigned pos = (unsigned)(P->p - P->mem);
+	unsigned long long len = P->len;
+	cell* mem;
+
+	while (len <= need)
+		len = (len <= 2147483648u) ? 2 * len : len + 104857600u;
+	if (len > 0xFFFFFFFFu) {
+		bt_alloc_error(P, 0xFFFFFFFFu);
+		return 0;
+	}
+
+	mem = (cell*)realloc(P->mem, (size_t)len * sizeof(cell));
+	if (mem == NULL) {
+		bt_alloc_error(P, (unsigned)len);
+		return 0;
+	}
+	memset(mem + P->len, 0, (size_t)(len - P->len) * sizeof(cell));
+	P->mem = mem;
+	P->p = mem + pos;
+	P->len = (unsigned)len;
+	return 1;
+}
+
+#if defined(BT_MEM_TAPELOOP)
+ #define BT_RIGHT(n) p = P->mem + (unsigned)(((unsigned long long)(p - P->mem) + (n)) % P->len);
+ #define BT_LEFT(n) p = P->mem + (unsigned)(((unsigned long long)(p - P->mem) + P->len - (n) % P->len) % P->len);
+#elif defined(BT_MEM_DYNAMIC)
+ #define BT_RIGHT(n) if ((unsigned long long)(p - P->mem) + (n) >= P->len) { SYNC(); if (!bt_grow(P, (unsigned long long)(p - P->mem) + (n))) return; LOAD(); } p += (n);
+ #define BT_LEFT(n) if ((unsigned)(p - P->mem) < (unsigned)(n)) { SYNC(); bt_range_error(P, (unsigned)-1); return; } p -= (n);
+#else
+ #define BT_RIGHT(n) if ((unsigned long long)(p - P->mem) + (n) >= P->len) { SYNC(); bt_range_error(P, P->len); return; } p += (n);
+ #define BT_LEFT(n) if ((unsigned)(p - P->mem) < (unsigned)(n)) { SYNC(); bt_range_error(P, (unsigned)-1); return; } p -= (n);
+#endif
+
+/* c = cell at offset o, reached like with moves */
+#define BT_AT(c, o) { const unsigned pos_ = (unsigned)(p - P->mem); \
+	if ((o) > 0) { BT_RIGHT(o) } else { BT_LEFT(-(o)) } \
+	c = p; p = P->mem + pos_; }
+
+/* cell[o] += cell * f */
+#define BT_MULADD(o, f) if (*p) { cell* t_; BT_AT(t_, o) *t_ = (cell)((unsigned)*t_ + (unsigned)*p * (unsigned)(f)); }
+
+/* [>] and [<], 8-bit cells search with memchr */
+#define BT_SCAN_RIGHT(s) while (*p) { \
+	if ((s) == 1 && sizeof(cell) == 1) { cell* z_ = (cell*)memchr(p, 0, P->len - (unsigned)(p - P->mem)); \
+		if (z_) { p = z_; break; } p = P->mem + P->len - 1; } \
+	BT_RIGHT(s) }
+#define BT_SCAN_LEFT(s) while (*p) { BT_LEFT(s) }
+
+static void bt_read(cell* p)
+{
+	int c;
+	fflush(stdout);
+	c = getchar();
+	if (c == EOF) {
+#if defined(BT_EOF_ZERO)
+		*p = 0;
+#elif defined(BT_EOF_MINUSONE)
+		*p = (cell)-1;
+#endif
+		return;
+	}
+	*p = (cell)c;
+}
+
+static int bt_decimal_read(bt_proc* P, cell* p)
+{
+	unsigned i;
+	int c;
+	fflush(stdout);
+	if (scanf("%u", &i) != 1) {
+		while ((c = getchar()) != '\n' && c != EOF);
+		bt_error(P, "Runtime Exception: Invalid input stream.");
+		return 0;
+	}
+	*p = (cell)i;
+	return 1;
+}
+
+static int bt_push(bt_proc* P, bt_heap* h, cell v)
+{
+	if (h->size > BT_STACK_LIMIT) {
+		bt_error(P, "Runtime Exception: Memory stack overflow.");
+		return 0;
+	}
+	if (h->size == h->cap) {
+		unsigned cap = h->cap ? 2 * h->cap : 64;
+		cell* data = (cell*)realloc(h->data, cap * sizeof(cell));
+		if (data == NULL) {
+			bt_alloc_error(P, cap);
+			return 0;
+		}
+		h->data = data;
+		h->cap = cap;
+	}
+	h->data[h->size++] = v;
+	return 1;
+}
+
+static cell bt_pop(bt_heap* h)
+{
+	return h->size ? h->data[--h->size] : 0;
+}
+
+static void bt_swap(bt_heap* h)
+{
+	cell tmp;
+	if (h->size < 2)
+		return;
+	tmp = h->data[h->size - 1];
+	h->data[h->size - 1] = h->data[h->size - 2];
+	h->data[h->size - 2] = tmp;
+}
+
+static int bt_shared_push(bt_proc* P, cell v)
+{
+	int ok;
+	pthread_mutex_lock(&bt_shared_lock);
+	ok = bt_push(P, &bt_shared_heap, v);
+	pthread_mutex_unlock(&bt_shared_lock);
+	return ok;
+}
+
+static cell bt_shared_pop(void)
+{
+	cell v;
+	pthread_mutex_lock(&bt_shared_lock);
+	v = bt_pop(&bt_shared_heap);
+	pthread_mutex_unlock(&bt_shared_lock);
+	return v;
+}
+
+static void bt_shared_swap(void)
+{
+	pthread_mutex_lock(&bt_shared_lock);
+	bt_swap(&bt_shared_heap);
+	pthread_mutex_unlock(&bt_shared_lock);
+}
+
+static unsigned bt_fn_slot(const bt_proc* P, ucell id)
+{
+	unsigned i = ((unsigned)id * 2654435761u) & (P->fn_cap - 1);
+	while (P->fn_ptrs[i] && P->fn_ids[i] != id)
+		i = (i + 1) & (P->fn_cap - 1);
+	return i;
+}
+
+static int bt_define(bt_proc* P, ucell id, bt_fn f)
+{
+	char msg[96];
+	unsigned i;
+
+	if (P->fn_cap && P->fn_ptrs[bt_fn_slot(P, id)]) {
+		snprintf(msg, sizeof(msg), "Runtime Exception: Function '%u' already exists.", (unsigned)(cell)id);
+		bt_error(P, msg);
+		return 0;
+	}
+	if (2 * (P->fn_count + 1) > P->fn_cap) {
+		bt_proc old = *P;
+		P->fn_cap = old.fn_cap ? 2 * old.fn_cap : 16;
+		P->fn_ids = (ucell*)calloc(P->fn_cap, sizeof(ucell));
+		P->fn_ptrs = (bt_fn*)calloc(P->fn_cap, sizeof(bt_fn));
+		if (P->fn_ids == NULL || P->fn_ptrs == NULL) {
+			bt_alloc_error(P, P->fn_cap);
+			return 0;
+		}
+		for (i = 0; i < old.fn_cap; ++i) {
+			if (old.fn_ptrs[i]) {
+				unsigned s = bt_fn_slot(P, old.fn_ids[i]);
+				P->fn_ids[s] = old.fn_ids[i];
+				P->fn_ptrs[s] = old.fn_ptrs[i];
+			}
+		}
+		free(old.fn_ids);
+		free(old.fn_ptrs);
+	}
+	i = bt_fn_slot(P, id);
+	P->fn_ids[i] = id;
+	P->fn_ptrs[i] = f;
+	++P->fn_count;
+	return 1;
+}
+
+/* tail calls return first and are run here, so they do not grow the stack */
+static void bt_run_tail(bt_proc* P)
+{
+	bt_fn f;
+	while ((f = P->tail) != NULL && !P->halt) {
+		P->tail = NULL;
+		f(P, 0);
+	}
+}
+
+static int bt_call_to(bt_proc* P, bt_fn f)
+{
+	if (P->depth > BT_STACK_LIMIT) {
+		bt_error(P, "Runtime Exception: Function's stack overflow.");
+		return 0;
+	}
+	++P->depth;
+	f(P, 0);
+	bt_run_tail(P);
+	--P->depth;
+	return !P->halt;
+}
+
+static bt_fn bt_lookup(bt_proc* P)
+{
+	char msg[96];
+	ucell id = (ucell)*P->p;
+	bt_fn f = P->fn_cap ? P->fn_ptrs[bt_fn_slot(P, id)] : NULL;
+
+	if (f == NULL) {
+		snprintf(msg, sizeof(msg), "Call to undefined function '%u'.", (unsigned)(cell)id);
+		bt_error(P, msg);
+	}
+	return f;
+}
+
+static int bt_call(bt_proc* P)
+{
+	bt_fn f = bt_lookup(P);
+	return f != NULL && bt_call_to(P, f);
+}
+
+static void bt_join(bt_proc* P)
+{
+	unsigned i;
+	for (i = 0; i < P->child_count; ++i)
+		pthread_join(P->children[i], NULL);
+	P->child_count = 0;
+}
+
+static void* bt_thread(void* arg)
+{
+	bt_proc* P = (bt_proc*)arg;
+	P->entry_fn(P, P->entry);
+	bt_run_tail(P);
+	bt_join(P);
+	bt_free_proc(P);
+	return NULL;
+}
+
+/* like BrainThreadProcess::Fork - the child gets a copy of the tape, an empty heap and no functions */
+static int bt_fork(bt_proc* P, bt_fn f, int entry)
+{
+	char msg[96];
+	int err;
+	bt_proc* C = bt_new_proc(P->len);
+	unsigned pos;
+
+	if (C == NULL) {
+		bt_error(P, "Runtime Exception: Cannot fork a thread. Reason: out of memory");
+		return 0;
+	}
+	memcpy(C->mem, P->mem, P->len * sizeof(cell));
+	C->p = C->mem + (P->p - P->mem);
+	*P->p = 0;
+
+	pos = (unsigned)(C->p - C->mem) + 1;
+	if (pos >= C->len) {
+#if defined(BT_MEM_TAPELOOP)
+		pos = 0;
+#elif defined(BT_MEM_DYNAMIC)
+		if (!bt_grow(C, pos)) {
+			bt_free_proc(C);
+			P->halt = 1;
+			return 0;
+		}
+#else
+		bt_free_proc(C);
+		bt_range_error(P, P->len);
+		return 0;
+#endif
+	}
+	C->p = C->mem + pos;
+	*C->p = 1;
+	C->entry_fn = f;
+	C->entry = entry;
+
+	if (P->child_count == P->child_cap) {
+		unsigned cap = P->child_cap ? 2 * P->child_cap : 8;
+		pthread_t* children = (pthread_t*)realloc(P->children, cap * sizeof(pthread_t));
+		if (children == NULL) {
+			bt_free_proc(C);
+			bt_error(P, "Runtime Exception: Cannot fork a thread. Reason: out of memory");
+			return 0;
+		}
+		P->children = children;
+		P->child_cap = cap;
+	}
+	if ((err = pthread_create(&P->children[P->child_count], NULL, bt_thread, C)) != 0) {
+		bt_free_proc(C);
+		snprintf(msg, sizeof(msg), "Runtime Exception: Cannot fork a thread. Reason: unknown. System error code: %d", err);
+		bt_error(P, msg);
+		return 0;
+	}
+	++P->child_count;
+	return 1;
+}
+)";
+
+	CodeGenerator::CodeGenerator(cellsize_option cellsize, mem_option mem_behavior, eof_option eof_behavior, unsigned int mem_size)
+		: cellsize(cellsize), mem_behavior(mem_behavior), eof_behavior(eof_behavior), mem_size(mem_size)
+	{
+	}
+
+	void CodeGenerator::Generate(const CodeTape& tape, std::ostream& o)
+	{
+		std::ostringstream bodies;
+
+		functions.clear();
+		EmitFunction(tape, 0, static_cast<unsigned int>(tape.size()), "bt_main", bodies);
+		for (size_t i = 0; i < functions.size(); ++i) //grows while nested functions are found
+		{
+			unsigned int pos = functions[i];
+			EmitFunction(tape, pos + 1, tape[pos].jump, GetFunctionName(pos), bodies);
+		}
+
+		EmitPrelude(o);
+
+		o << "\nstatic void bt_main(bt_proc* P, int entry);\n";
+		for (unsigned int pos : functions)
+			o << "static void " << GetFunctionName(pos) << "(bt_proc* P, int entry);\n";
+
+		o << bodies.str();
+		EmitMain(o);
+	}
+
+	void CodeGenerator::EmitPrelude(std::ostream& o) const
+	{
+		o << "/* Generated by BrainThread */\n"
+			<< "#include <stdio.h>\n"
+			<< "#include <stdlib.h>\n"
+			<< "#include <string.h>\n"
+			<< "#include <pthread.h>\n\n";
+
+		o << "typedef " << GetCellType() << " cell;\n"
+			<< "typedef unsigned " << (sizeof(int) == 4 && (cellsize == cellsize_option::cs32 || cellsize == cellsize_option::csu32) ? "int" :
+				(cellsize == cellsize_option::cs16 || cellsize == cellsize_option::csu16) ? "short" : "char") << " ucell;\n\n";
+
+		o << "#define BT_MEM_SIZE " << mem_size << "u\n";
+		switch (mem_behavior)
+		{
+			case mem_option::moContinuousTape: o << "#define BT_MEM_TAPELOOP\n"; break;
+			case mem_option::moDynamic: o << "#define BT_MEM_DYNAMIC\n"; break;
+			case mem_option::moLimited:
+			default: o << "#define BT_MEM_LIMITED\n";
+		}
+		switch (eof_behavior)
+		{
+			case eof_option::eoMinusOne: o << "#define BT_EOF_MINUSONE\n"; break;
+			case eof_option::eoUnchanged: o << "#define BT_EOF_UNCHANGED\n"; break;
+			case eof_option::eoZero:
+			default: o << "#define BT_EOF_ZERO\n";
+		}
+
+		o << c_runtime;
+	}
+
+	//body of the main program or a function, forks inside are entry points for new threads
+	void CodeGenerator::EmitFunction(const CodeTape& tape, unsigned int begin, unsigned int end, const std::string& name, std::ostream& o)
+	{
+		std::ostringstream body;
+		std::vector<unsigned int> entries;
+		std::string indent = "\t";
+		bool uses_offsets = false;
+
+		for (unsigned int i = begin; i < end; ++i)
+		{
+			const bt_instruction& ins = tape[i];
+			std::string cell = "p";
+
+			if (ins.offset != 0 && CodeAnalyser::IsOffsetInstruction(ins))
+			{
+				body << indent << "BT_AT(c, " << ins.offset << ")\n";
+				cell = "c";
+				uses_offsets = true;
+			}
+
+			switch (ins.operation)
+			{
+			case bt_operation::btoIncrement: body << indent << "++*p;\n"; break;
+			case bt_operation::btoDecrement: body << indent << "--*p;\n"; break;
+			case bt_operation::btoOPT_Increment: body << indent << "*" << cell << " += " << ins.repetitions << ";\n"; break;
+			case bt_operation::btoOPT_Decrement: body << indent << "*" << cell << " -= " << ins.repetitions << ";\n"; break;
+			case bt_operation::btoOPT_SetCellToZero: body << indent << "*" << cell << " = 0;\n"; break;
+			case bt_operation::btoOPT_MulAdd: body << indent << "BT_MULADD(" << ins.offset << ", " << ins.repetitions << ")\n"; break;
+			case bt_operation::btoOPT_MulSub: body << indent << "BT_MULADD(" << ins.offset << ", -" << ins.repetitions << ")\n"; break;
+			case bt_operation::btoOPT_ScanRight: body << indent << "BT_SCAN_RIGHT(" << ins.repetitions << ")\n"; break;
+			case bt_operation::btoOPT_ScanLeft: body << indent << "BT_SCAN_LEFT(" << ins.repetitions << ")\n"; break;
+
+			case bt_operation::btoMoveRight: body << indent << "BT_RIGHT(1)\n"; break;
+			case bt_operation::btoMoveLeft: body << indent << "BT_LEFT(1)\n"; break;
+			case bt_operation::btoOPT_MoveRight: body << indent << "BT_RIGHT(" << ins.repetitions << ")\n"; break;
+			case bt_operation::btoOPT_MoveLeft: body << indent << "BT_LEFT(" << ins.repetitions << ")\n"; break;
+
+			case bt_operation::btoAsciiWrite: body << indent << "putchar((char)*" << cell << ");\n"; break;
+			case bt_operation::btoAsciiRead: body << indent << "bt_read(" << cell << ");\n"; break;
+			case bt_operation::btoDecimalWrite:
+				if (IsSignedCell())
+					body << indent << "printf(\"%d\", (int)*" << cell << ");\n";
+				else
+					body << indent << "printf(\"%u\", (unsigned)*" << cell << ");\n";
+				break;
+			case bt_operation::btoDecimalRead: body << indent << "if (!bt_decimal_read(P, " << cell << ")) return;\n"; break;
+
+			case bt_operation::btoBeginLoop:
+				body << indent << "while (*p) {\n";
+				indent += '\t';
+				break;
+			case bt_operation::btoEndLoop:
+				indent.pop_back();
+				body << indent << "}\n";
+				break;
+
+			case bt_operation::btoBeginFunction:
+				functions.push_back(i);
+				body << indent << "SYNC(); if (!bt_define(P, (ucell)*p, " << GetFunctionName(i) << ")) return;\n";
+				i = ins.jump; //body is a separate function
+				break;
+			case bt_operation::btoCallFunction:
+				if (tape[i + 1].operation == bt_operation::btoEndFunction) //tail call
+					body << indent << "SYNC(); P->tail = bt_lookup(P); return;\n";
+				else
+					body << indent << "SYNC(); if (!bt_call(P)) return; LOAD();\n";
+				break;
+			case bt_operation::btoOPT_CallFunction:
+				if (tape[i + 1].operation == bt_operation::btoEndFunction)
+					body << indent << "SYNC(); P->tail = " << GetFunctionName(ins.jump) << "; return;\n";
+				else
+					body << indent << "SYNC(); if (!bt_call_to(P, " << GetFunctionName(ins.jump) << ")) return; LOAD();\n";
+				break;
+
+			case bt_operation::btoFork:
+				entries.push_back(i + 1);
+				body << indent << "SYNC(); if (!bt_fork(P, " << name << ", " << (i + 1) << ")) return;\n"
+					<< indent << "L" << (i + 1) << ":;\n";
+				break;
+			case bt_operation::btoJoin: body << indent << "bt_join(P);\n"; break;
+			case bt_operation::btoTerminate: body << indent << "SYNC(); P->halt = 1; return;\n"; break;
+
+			case bt_operation::btoPush: body << indent << "if (!bt_push(P, &P->heap, *p)) return;\n"; break;
+			case bt_operation::btoPop: body << indent << "*p = bt_pop(&P->heap);\n"; break;
+			case bt_operation::btoSwap: body << indent << "bt_swap(&P->heap);\n"; break;
+			case bt_operation::btoOPT_PushRun:
+			case bt_operation::btoOPT_PopRun: //cell by cell, the compiler joins the moves
+				for (int k = 0; ; k += (ins.offset < 0 ? -1 : 1)) {
+					if (ins.operation == bt_operation::btoOPT_PushRun)
+						body << indent << "if (!bt_push(P, &P->heap, *p)) return;\n";
+					else
+						body << indent << "*p = bt_pop(&P->heap);\n";
+					if (k == ins.offset)
+						break;
+					body << indent << (ins.offset < 0 ? "BT_LEFT(1)\n" : "BT_RIGHT(1)\n");
+				}
+				break;
+			case bt_operation::btoSharedPush: body << indent << "if (!bt_shared_push(P, *p)) return;\n"; break;
+			case bt_operation::btoSharedPop: body << indent << "*p = bt_shared_pop();\n"; break;
+			case bt_operation::btoSharedSwap: body << indent << "bt_shared_swap();\n"; break;
+
+			case bt_operation::btoEndProgram: break;
+			case bt_operation::btoOPT_NoOperation:
+			case bt_operation::btoSwitchHeap:
+				break;
+			default:
+				body << indent << "/* debug instruction skipped */\n";
+			}
+		}
+
+		o << "\nstatic void " << name << "(bt_proc* P, int entry)\n{\n"
+			<< "\tcell* p = P->p;\n";
+		if (uses_offsets)
+			o << "\tcell* c;\n";
+
+		if (entries.empty())
+			o << "\t(void)entry;\n";
+		else
+		{
+			o << "\tswitch (entry) {\n";
+			for (unsigned int e : entries)
+				o << "\t\tcase " << e << ": goto L" << e << ";\n";
+			o << "\t}\n";
+		}
+
+		o << body.str()
+			<< "\tSYNC();\n}\n";
+	}
+
+	void CodeGenerator::EmitMain(std::ostream& o) const
+	{
+		o << "\nint main(void)\n{\n"
+			<< "\tbt_proc* P = bt_new_proc(BT_MEM_SIZE);\n"
+			<< "\tif (P == NULL) {\n"
+			<< "\t\tfprintf(stderr, \"Runtime Exception: Cannot allocate %u cells of memory.\\n\", BT_MEM_SIZE);\n"
+			<< "\t\treturn 1;\n"
+			<< "\t}\n"
+			<< "\tbt_main(P, 0);\n"
+			<< "\tbt_join(P);\n"
+			<< "\tfflush(stdout);\n"
+			<< "\tbt_free_proc(P);\n"
+			<< "\treturn 0;\n"
+			<< "}\n";
+	}
+
+	const char* CodeGenerator::GetCellType() const
+	{
+		switch (cellsize)
+		{
+			case cellsize_option::cs16: return "short";
+			case cellsize_option::cs32: return "int";
+			case cellsize_option::csu8: return "unsigned char";
+			case cellsize_option::csu16: return "unsigned short";
+			case cellsize_option::csu32: return "unsigned int";
+			case cellsize_option::cs8:
+			default: return "char";
+		}
+	}
+
+	bool CodeGenerator::IsSignedCell() const
+	{
+		return cellsize == cellsize_option::cs8 || cellsize == cellsize_option::cs16 || cellsize == cellsize_option::cs32;
+	}
+
+	std::string CodeGenerator::GetFunctionName(unsigned int pos)
+	{
+		return "bt_f" + std::to_string(pos);
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include "Enumdefs.h"
+#include "CodeTape.h"
+
+namespace BT {
+
+	/*
+	 * Klasa CodeGenerator
+	 * Translates a valid code tape into a standalone C program (C99 + pthreads)
+	 * with the same cell type, memory and EOF behavior as the interpreter.
+	 * Every pBrain function becomes a C function registered in a dispatch table
+	 * and every fork becomes a pthread entering the forking function at the
+	 * instruction after the fork.
+	*/
+	class CodeGenerator
+	{
+	public:
+		CodeGenerator(cellsize_option cellsize, mem_option mem_behavior, eof_option eof_behavior, unsigned int mem_size);
+
+		void Generate(const CodeTape& tape, std::ostream& o);
+
+	protected:
+		const cellsize_option cellsize;
+		const mem_option mem_behavior;
+		const eof_option eof_behavior;
+		const unsigned int mem_size;
+
+		std::vector<unsigned int> functions; //positions of the '(' left to generate
+
+		void EmitPrelude(std::ostream& o) const;
+		void EmitFunction(const CodeTape& tape, unsigned int begin, unsigned int end, const std::string& name, std::ostream& o);
+		void EmitMain(std::ostream& o) const;
+
+		const char* GetCellType() const;
+		bool IsSignedCell() const;
+
+		static std::string GetFunctionName(unsigned int pos);
+	};
+}
@@ -0,0 +1,159 @@
+#include "CodeGraph.h"
+#include "CodeAnalyser.h"
+
+#include <algorithm>
+
+namespace BT {
+
+	//the tape has to be linked (valid syntax)
+	CodeGraph::CodeGraph(const CodeTape& tape) : tape_size(tape.size())
+	{
+		std::stack<code_node*> open; //loops and functions, the top one gets the new nodes
+		auto body = [&]() -> std::vector<code_node>& {
+			return open.empty() ? nodes : open.top()->body;
+		};
+
+		for (const bt_instruction& ins : tape)
+		{
+			if (ins.operation == bt_operation::btoBeginFunction)
+				definitions.push_back(static_cast<unsigned int>(&ins - tape.data()));
+
+			switch (ins.operation)
+			{
+			case bt_operation::btoBeginLoop:
+			case bt_operation::btoBeginFunction:
+				body().emplace_back(ins.operation == bt_operation::btoBeginLoop ? node_kind::nkLoop : node_kind::nkFunction);
+				body().back().instructions.push_back(ins);
+				open.push(&body().back());
+				break;
+			case bt_operation::btoEndLoop:
+			case bt_operation::btoEndFunction:
+				open.top()->instructions.push_back(ins);
+				Summarize(*open.top());
+				open.pop();
+				break;
+			case bt_operation::btoCallFunction:
+			case bt_operation::btoOPT_CallFunction:
+			case bt_operation::btoFork:
+				body().emplace_back(ins.operation == bt_operation::btoFork ? node_kind::nkFork : node_kind::nkCall);
+				body().back().instructions.push_back(ins);
+				body().back().fixed = false;
+				break;
+			default:
+				if (body().empty() || body().back().kind != node_kind::nkBlock)
+					body().emplace_back(node_kind::nkBlock);
+				body().back().instructions.push_back(ins);
+				Summarize(body().back());
+				break;
+			}
+		}
+	}
+
+	//blocks are summarized after every new instruction, loops and functions when closed
+	void CodeGraph::Summarize(code_node& node)
+	{
+		if (!node.fixed)
+			return;
+
+		if (node.kind == node_kind::nkBlock)
+		{
+			const bt_instruction& ins = node.instructions.back();
+			switch (ins.operation)
+			{
+			case bt_operation::btoMoveRight:
+			case bt_operation::btoOPT_MoveRight: node.shift += ins.repetitions; break;
+			case bt_operation::btoMoveLeft:
+			case bt_operation::btoOPT_MoveLeft: node.shift -= ins.repetitions; break;
+			case bt_operation::btoOPT_PushRun:
+			case bt_operation::btoOPT_PopRun: node.shift += ins.offset; break;
+			case bt_operation::btoOPT_MulAdd:
+			case bt_operation::btoOPT_MulSub:
+				node.lowest = std::min(node.lowest, node.shift + ins.offset);
+				node.highest = std::max(node.highest, node.shift + ins.offset);
+				break;
+			case bt_operation::btoIncrement:
+			case bt_operation::btoDecrement:
+			case bt_operation::btoPush:
+			case bt_operation::btoPop:
+			case bt_operation::btoSwap:
+			case bt_operation::btoSharedPush:
+			case bt_operation::btoSharedPop:
+			case bt_operation::btoSharedSwap:
+			case bt_operation::btoSwitchHeap:
+			case bt_operation::btoOPT_NoOperation:
+			case bt_operation::btoEndProgram:
+				break;
+			default:
+				if (CodeAnalyser::IsOffsetInstruction(ins)) {
+					node.lowest = std::min(node.lowest, node.shift + ins.offset);
+					node.highest = std::max(node.highest, node.shift + ins.offset);
+				}
+				else node.fixed = false; //scans, threads, debug
+				break;
+			}
+			node.lowest = std::min(node.lowest, node.shift);
+			node.highest = std::max(node.highest, node.shift);
+		}
+		else if (node.kind == node_kind::nkLoop)
+		{
+			//every iteration has to end on the loop cell
+			int offset = 0;
+			for (const code_node& inner : node.body)
+			{
+				if (!inner.fixed) {
+					node.fixed = false;
+					return;
+				}
+				node.lowest = std::min(node.lowest, offset + inner.lowest);
+				node.highest = std::max(node.highest, offset + inner.highest);
+				offset += inner.shift;
+			}
+			node.fixed = (offset == 0);
+		}
+		else node.fixed = false;
+	}
+
+	unsigned int CodeGraph::Size(const code_node& node)
+	{
+		unsigned int size = static_cast<unsigned int>(node.instructions.size());
+		for (const code_node& inner : node.body)
+			size += Size(inner);
+		return size;
+	}
+
+	CodeTape CodeGraph::Lower() const
+	{
+		CodeTape tape;
+		tape.reserve(tape_size);
+		Lower(nodes, tape);
+
+		//resolved calls go to the new position of the same definition
+		std::vector<unsigned int> moved;
+		for (unsigned int i = 0; i < tape.size(); ++i)
+			if (tape[i].operation == bt_operation::btoBeginFunction)
+				moved.push_back(i);
+
+		for (bt_instruction& ins : tape)
+			if (ins.operation == bt_operation::btoOPT_CallFunction)
+				ins.jump = moved[std::lower_bound(definitions.begin(), definitions.end(), ins.jump) - definitions.begin()];
+		return tape;
+	}
+
+	void CodeGraph::Lower(const std::vector<code_node>& nodes, CodeTape& tape)
+	{
+		for (const code_node& node : nodes)
+		{
+			if (node.kind == node_kind::nkLoop || node.kind == node_kind::nkFunction)
+			{
+				unsigned int begin = static_cast<unsigned int>(tape.size());
+				tape.push_back(node.instructions.front());
+				Lower(node.body, tape);
+				tape.push_back(node.instructions.back());
+
+				tape[begin].jump = static_cast<unsigned int>(tape.size() - 1);
+				tape.back().jump = begin;
+			}
+			else tape.insert(tape.end(), node.instructions.begin(), node.instructions.end());
+		}
+	}
+}
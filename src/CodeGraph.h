@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vector>
+#include <stack>
+
+#include "CodeTape.h"
+
+namespace BT {
+
+	enum class node_kind
+	{
+		nkBlock, //straight-line instructions
+		nkLoop,
+		nkFunction,
+		nkCall,
+		nkFork //the nodes after a fork in the same body are run by both threads
+	};
+
+	/*
+	 * A node of the code graph. Loops and functions keep their brackets in instructions
+	 * and the nodes inside them in body, the other nodes keep their own instructions.
+	*/
+	struct code_node
+	{
+		node_kind kind;
+		std::vector<bt_instruction> instructions;
+		std::vector<code_node> body;
+
+		//what the node does with the pointer, relative to where it starts
+		int shift = 0;
+		int lowest = 0;
+		int highest = 0;
+		bool fixed = true; //false - the pointer moves depend on the data, shift and the range are unknown
+
+		code_node(node_kind kind) : kind(kind) {}
+	};
+
+	/*
+	 * Klasa CodeGraph
+	 * Structured view of a linked code tape: blocks, loops, functions, calls and forks.
+	 * Passes which work on whole blocks or loops change the nodes, Lower() gives
+	 * the tape back with the jumps linked again. Passes may move the functions,
+	 * but must not add or remove them.
+	*/
+	class CodeGraph
+	{
+	public:
+		CodeGraph(const CodeTape& tape);
+
+		CodeTape Lower() const;
+
+		//instructions of the node and everything inside it
+		static unsigned int Size(const code_node& node);
+
+		std::vector<code_node>& Nodes() { return nodes; }
+		const std::vector<code_node>& Nodes() const { return nodes; }
+
+		//visits every node, outer ones first
+		template <typename Fn>
+		void ForEach(Fn fn)
+		{
+			std::stack<code_node*> pending;
+			for (auto it = nodes.rbegin(); it != nodes.rend(); ++it)
+				pending.push(&*it);
+
+			while (!pending.empty()) {
+				code_node* node = pending.top();
+				pending.pop();
+				fn(*node);
+				for (auto it = node->body.rbegin(); it != node->body.rend(); ++it)
+					pending.push(&*it);
+			}
+		}
+
+	protected:
+		std::vector<code_node> nodes;
+		CodeTape::size_type tape_size;
+		std::vector<unsigned int> definitions; //positions of the functions in the tape, resolved calls point to them
+
+		static void Summarize(code_node& node);
+		static void Lower(const std::vector<code_node>& nodes, CodeTape& tape);
+	};
+}
@@ -4,7 +4,7 @@
 #include <climits> 
 
 namespace BT {
-	enum class bt_operation
+	enum class bt_operation : unsigned char
 	{
 		btoDecrement = 1,
 		btoIncrement,
@@ -41,6 +41,13 @@ namespace BT {
 		//wrapped, optimized instructions
 		btoOPT_SetCellToZero,
 		btoOPT_NoOperation,
+		btoOPT_MulAdd, //cell[offset] += cell * repetitions
+		btoOPT_MulSub, //cell[offset] -= cell * repetitions
+		btoOPT_ScanRight, //[>], repetitions is the stride
+		btoOPT_ScanLeft, //[<]
+		btoOPT_CallFunction, //call of a known function, jump is its definition
+		btoOPT_PushRun, //&>&>&, offset is the last cell, the pointer ends on it
+		btoOPT_PopRun, //^>^>^
 
 		//debug instructions
 		btoDEBUG_SimpleMemoryDump = 100,
@@ -57,14 +64,24 @@ namespace BT {
 		btoUnkown = 0
 	};
 
+	/*
+	 * One instruction in 8 bytes. Loops and functions keep the position of their pair in jump
+	 * (resolved calls the position of the definition),
+	 * the other instructions the cell they work on (relative to the pointer) in offset.
+	 * A balanced loop keeps the window of cells it touches: [ the number of cells, ] how far
+	 * the first one is left of the loop cell (see Parser::FindLoopRanges).
+	*/
 	struct bt_instruction
 	{
 		bt_operation operation;
 		unsigned short repetitions;
-		unsigned int jump;
+		union {
+			unsigned int jump;
+			int offset;
+		};
 		
 		bt_instruction(bt_operation op, unsigned int index, unsigned short reps)
-			: operation(op), jump(index), repetitions(reps) {};
+			: operation(op), repetitions(reps), jump(IsJump(op) ? index : 0) {};
 		bt_instruction(bt_operation op, unsigned int index)
 			: bt_instruction(op, index, 1) {};
 		bt_instruction(bt_operation op)
@@ -72,8 +89,16 @@ namespace BT {
 		bt_instruction() 
 			: bt_instruction(bt_operation::btoUnkown) {};
 
-		bool IsLinked() const { return jump < UINT_MAX; }
+		bool IsLinked() const { return IsJump(operation) && jump < UINT_MAX; }
+
+		static bool IsJump(bt_operation op) {
+			return op == bt_operation::btoBeginLoop || op == bt_operation::btoEndLoop ||
+				op == bt_operation::btoBeginFunction || op == bt_operation::btoEndFunction ||
+				op == bt_operation::btoOPT_CallFunction;
+		}
 	};
+
+	static_assert(sizeof(bt_instruction) == 8, "bt_instruction should stay packed");
 	
 	typedef std::vector<bt_instruction> CodeTape;
 	typedef CodeTape::iterator CodeTapeIterator;
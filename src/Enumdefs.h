@@ -20,6 +20,32 @@ namespace BT {
 		eoUnchanged
 	};
 
+	//explicit instantiation of a class template for one cell type with every memory and EOF behavior
+	#define BT_INSTANTIATE_BEHAVIORS(TEMPLATE, T) \
+		template class TEMPLATE<T, mem_option::moLimited, eof_option::eoZero>; \
+		template class TEMPLATE<T, mem_option::moLimited, eof_option::eoMinusOne>; \
+		template class TEMPLATE<T, mem_option::moLimited, eof_option::eoUnchanged>; \
+		template class TEMPLATE<T, mem_option::moDynamic, eof_option::eoZero>; \
+		template class TEMPLATE<T, mem_option::moDynamic, eof_option::eoMinusOne>; \
+		template class TEMPLATE<T, mem_option::moDynamic, eof_option::eoUnchanged>; \
+		template class TEMPLATE<T, mem_option::moContinuousTape, eof_option::eoZero>; \
+		template class TEMPLATE<T, mem_option::moContinuousTape, eof_option::eoMinusOne>; \
+		template class TEMPLATE<T, mem_option::moContinuousTape, eof_option::eoUnchanged>;
+
+	enum class engine_option
+	{
+		enSwitch,
+		enThreaded,
+		enJit
+	};
+
+	enum class thread_option
+	{
+		toSystem, //a system thread for every fork
+		toPool, //forks are tasks of a worker pool
+		toFiber //forks are fibers on a few system threads
+	};
+
 	enum class CodeLang
 	{
 		clBrainThread,
@@ -0,0 +1,329 @@
+#include "FiberScheduler.h"
+
+#ifdef BT_FIBERS
+
+#include <new>
+#include <algorithm>
+
+#include <unistd.h>
+#include <sys/mman.h>
+
+#if defined(__SANITIZE_THREAD__)
+	#define BT_FIBER_TSAN
+#elif defined(__has_feature)
+	#if __has_feature(thread_sanitizer)
+		#define BT_FIBER_TSAN
+	#endif
+#endif
+
+#ifdef BT_FIBER_TSAN
+	#include <sanitizer/tsan_interface.h>
+#endif
+
+#ifdef BT_FIBER_SWITCH
+/*
+ * bt_fiber_switch(from, to) saves the callee-saved registers and the SSE and x87 control
+ * words on the current stack, stores the stack pointer in *from and restores the same
+ * from the stack at to. A new fiber gets a stack which returns into FiberScheduler::Entry.
+*/
+extern "C" void bt_fiber_switch(void** from, void* to);
+
+asm(R"(
+	.text
+	.globl bt_fiber_switch
+	.hidden bt_fiber_switch
+	.type bt_fiber_switch, @function
+bt_fiber_switch:
+	pushq %rbp
+	pushq %rbx
+	pushq %r12
+	pushq %r13
+	pushq %r14
+	pushq %r15
+	subq $8, %rsp
+	stmxcsr (%rsp)
+	fnstcw 4(%rsp)
+	movq %rsp, (%rdi)
+	movq %rsi, %rsp
+	ldmxcsr (%rsp)
+	fldcw 4(%rsp)
+	addq $8, %rsp
+	popq %r15
+	popq %r14
+	popq %r13
+	popq %r12
+	popq %rbx
+	popq %rbp
+	ret
+	.size bt_fiber_switch, .-bt_fiber_switch
+)");
+#endif
+
+namespace BT {
+
+	enum fiber_request { frYield, frPark, frEnd };
+	enum fiber_state { fsRunning, fsParked, fsWoken };
+
+	static thread_local FiberScheduler::fiber* current_fiber = nullptr;
+	static thread_local void* current_carrier = nullptr;
+
+	FiberScheduler& FiberScheduler::Instance()
+	{
+		static FiberScheduler scheduler(std::max(1u, std::thread::hardware_concurrency()));
+		return scheduler;
+	}
+
+	FiberScheduler::FiberScheduler(unsigned int n)
+	{
+		for (unsigned int i = 0; i < n; ++i)
+			carriers.push_back(std::make_unique<carrier>());
+
+		for (unsigned int i = 0; i < n; ++i)
+			threads.emplace_back(&FiberScheduler::Work, this, i);
+	}
+
+	//all the fibers have been joined by now
+	FiberScheduler::~FiberScheduler()
+	{
+		stopping.store(true);
+		for (std::unique_ptr<carrier>& c : carriers) {
+			{
+				std::lock_guard<std::mutex> lock(c->mutex);
+			}
+			c->ready.notify_all();
+		}
+
+		for (std::thread& t : threads)
+			t.join();
+
+		for (char* stack : free_stacks)
+			munmap(stack - sysconf(_SC_PAGESIZE), stack_size + static_cast<size_t>(sysconf(_SC_PAGESIZE)));
+	}
+
+	//carriers are given out in turn, the fiber stays on its carrier
+	void FiberScheduler::Spawn(fiber* f, latch& parent)
+	{
+		Start(f);
+		f->parent = &parent;
+		f->carrier = next_carrier.fetch_add(1) % carriers.size();
+		parent.count.fetch_add(1);
+		Push(f);
+	}
+
+	void FiberScheduler::Push(fiber* f)
+	{
+		carrier& c = *carriers[f->carrier];
+		{
+			std::lock_guard<std::mutex> lock(c.mutex);
+			c.fibers.push_back(f);
+		}
+		c.ready.notify_one();
+	}
+
+	//a parked fiber goes back to its carrier, a running one does not park
+	void FiberScheduler::Wake(fiber* f)
+	{
+		if (f->state.exchange(fsWoken) == fsParked) {
+			f->state.store(fsRunning);
+			Push(f);
+		}
+	}
+
+	//the latch may be gone once the waiter sees zero, the waiter leaves through the mutex
+	void FiberScheduler::Done(latch& children)
+	{
+		fiber* w;
+		{
+			std::lock_guard<std::mutex> lock(children.mutex);
+			if (children.count.fetch_sub(1) != 1)
+				return;
+			w = children.waiter.load();
+			children.zero.notify_all();
+		}
+
+		if (w)
+			Wake(w);
+	}
+
+	void FiberScheduler::Join(latch& children)
+	{
+		fiber* const self = current_fiber;
+		if (self == nullptr) {
+			std::unique_lock<std::mutex> lock(children.mutex);
+			children.zero.wait(lock, [&children]() { return children.count.load() == 0; });
+			return;
+		}
+
+		while (children.count.load() > 0) {
+			children.waiter.store(self);
+			if (children.count.load() > 0)
+				Stop(self, frPark);
+			children.waiter.store(nullptr);
+		}
+
+		std::lock_guard<std::mutex> lock(children.mutex);
+	}
+
+	FiberScheduler::fiber* FiberScheduler::Current()
+	{
+		return current_fiber;
+	}
+
+	void FiberScheduler::Park()
+	{
+		Stop(current_fiber, frPark);
+	}
+
+	void FiberScheduler::Yield()
+	{
+		if (current_fiber)
+			Stop(current_fiber, frYield);
+		else
+			std::this_thread::yield();
+	}
+
+	//back to the carrier, which puts the fiber away as asked
+	void FiberScheduler::Stop(fiber* f, int request)
+	{
+		f->request = request;
+		carrier& c = *static_cast<carrier*>(current_carrier);
+#ifdef BT_FIBER_TSAN
+		__tsan_switch_to_fiber(c.tsan, 0);
+#endif
+#ifdef BT_FIBER_SWITCH
+		bt_fiber_switch(&f->sp, c.sp);
+#else
+		swapcontext(&f->context, &c.context);
+#endif
+	}
+
+	void FiberScheduler::Entry()
+	{
+		fiber* const f = current_fiber;
+		f->Run();
+		Stop(f, frEnd);
+	}
+
+	//the stack of a new fiber starts in Entry
+	void FiberScheduler::Start(fiber* f)
+	{
+		f->stack = AllocateStack();
+#ifdef BT_FIBER_TSAN
+		f->tsan = __tsan_create_fiber(0);
+#endif
+#ifdef BT_FIBER_SWITCH
+		void** sp = reinterpret_cast<void**>(f->stack + stack_size);
+		*--sp = nullptr; //Entry starts like a called function, 8 bytes below a 16 byte boundary
+		*--sp = reinterpret_cast<void*>(&FiberScheduler::Entry);
+		for (int i = 0; i < 6; ++i)
+			*--sp = nullptr; //rbp, rbx, r12 - r15
+		*--sp = reinterpret_cast<void*>(0x037F00001F80ull); //default x87 and SSE control words
+		f->sp = sp;
+#else
+		getcontext(&f->context);
+		f->context.uc_stack.ss_sp = f->stack;
+		f->context.uc_stack.ss_size = stack_size;
+		f->context.uc_link = nullptr;
+		makecontext(&f->context, &FiberScheduler::Entry, 0);
+#endif
+	}
+
+	void FiberScheduler::Work(unsigned int self)
+	{
+		carrier& c = *carriers[self];
+		current_carrier = &c;
+#ifdef BT_FIBER_TSAN
+		c.tsan = __tsan_get_current_fiber();
+#endif
+
+		while (true)
+		{
+			fiber* f;
+			{
+				std::unique_lock<std::mutex> lock(c.mutex);
+				c.ready.wait(lock, [this, &c]() { return !c.fibers.empty() || stopping.load(); });
+				if (c.fibers.empty())
+					return;
+				f = c.fibers.front();
+				c.fibers.pop_front();
+			}
+
+			current_fiber = f;
+#ifdef BT_FIBER_TSAN
+			__tsan_switch_to_fiber(f->tsan, 0);
+#endif
+#ifdef BT_FIBER_SWITCH
+			bt_fiber_switch(&c.sp, f->sp);
+#else
+			swapcontext(&c.context, &f->context);
+#endif
+			current_fiber = nullptr;
+
+			switch (f->request)
+			{
+			case frYield:
+				{
+					bool alone;
+					{
+						std::lock_guard<std::mutex> lock(c.mutex);
+						alone = c.fibers.empty();
+						c.fibers.push_back(f);
+					}
+					if (alone)
+						std::this_thread::yield(); //no other fiber here, the other system threads get the core
+				}
+				break;
+			case frPark:
+				{
+					int running = fsRunning;
+					if (!f->state.compare_exchange_strong(running, fsParked)) {
+						f->state.store(fsRunning); //woken meanwhile
+						std::lock_guard<std::mutex> lock(c.mutex);
+						c.fibers.push_back(f);
+					}
+				}
+				break;
+			case frEnd:
+				{
+					//the parent may free the fiber as soon as it learns about the end
+					latch& parent = *f->parent;
+					FreeStack(f->stack);
+					f->stack = nullptr;
+#ifdef BT_FIBER_TSAN
+					__tsan_destroy_fiber(f->tsan);
+#endif
+					Done(parent);
+				}
+				break;
+			}
+		}
+	}
+
+	//a guard page below every stack
+	char* FiberScheduler::AllocateStack()
+	{
+		{
+			std::lock_guard<std::mutex> lock(stacks_mutex);
+			if (!free_stacks.empty()) {
+				char* const stack = free_stacks.back();
+				free_stacks.pop_back();
+				return stack;
+			}
+		}
+
+		const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+		void* const m = mmap(nullptr, stack_size + page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (m == MAP_FAILED)
+			throw std::bad_alloc();
+		mprotect(m, page, PROT_NONE);
+		return static_cast<char*>(m) + page;
+	}
+
+	void FiberScheduler::FreeStack(char* stack)
+	{
+		std::lock_guard<std::mutex> lock(stacks_mutex);
+		free_stacks.push_back(stack);
+	}
+}
+
+#endif
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+
+#if defined(__x86_64__) && defined(__linux__) && (defined(__GNUC__) || defined(__clang__))
+	#define BT_FIBERS
+	#define BT_FIBER_SWITCH //own context switch, saves only what the ABI asks to keep
+#elif defined(__unix__) || defined(__APPLE__)
+	#define BT_FIBERS
+	#include <ucontext.h>
+#endif
+
+#ifdef BT_FIBERS
+namespace BT {
+
+	/*
+	 * Klasa FiberScheduler
+	 * Forked processes as fibers: small stacks switched in user space and run by a few
+	 * carrier threads, one per core. A fiber stays on the carrier it gets when forked and
+	 * gives it to the next fiber at loop back-edges and quantum ends. A fiber waiting
+	 * in } is parked until its last child ends, a system thread waits for it as usual.
+	*/
+	class FiberScheduler
+	{
+	public:
+		class latch;
+
+		class fiber
+		{
+		public:
+			virtual ~fiber(void) = default;
+			virtual void Run(void) = 0;
+
+		private:
+			friend class FiberScheduler;
+
+#ifdef BT_FIBER_SWITCH
+			void* sp = nullptr;
+#else
+			ucontext_t context;
+#endif
+			char* stack = nullptr;
+			unsigned int carrier = 0;
+			int request = 0; //what the carrier does after the fiber stops
+			std::atomic<int> state{ 0 }; //running, parked or woken before it could park
+			latch* parent = nullptr;
+			void* tsan = nullptr;
+		};
+
+		//fibers of a process which have not ended yet
+		class latch
+		{
+		private:
+			friend class FiberScheduler;
+
+			std::atomic<int> count{ 0 };
+			std::atomic<fiber*> waiter{ nullptr };
+			std::mutex mutex;
+			std::condition_variable zero;
+		};
+
+		static FiberScheduler& Instance(void);
+
+		void Spawn(fiber* f, latch& parent);
+		void Join(latch& children);
+
+		//rest of the time slice for the others, outside a fiber for the other threads
+		static void Yield(void);
+
+		//the running fiber stops until somebody wakes it, a wake which comes first is not lost
+		static fiber* Current(void);
+		static void Park(void);
+		void Wake(fiber* f);
+
+		unsigned int Carriers() const { return static_cast<unsigned int>(threads.size()); }
+
+	protected:
+		FiberScheduler(unsigned int carriers);
+		~FiberScheduler(void);
+
+		struct carrier
+		{
+#ifdef BT_FIBER_SWITCH
+			void* sp = nullptr;
+#else
+			ucontext_t context;
+#endif
+			void* tsan = nullptr;
+			std::mutex mutex;
+			std::condition_variable ready;
+			std::deque<fiber*> fibers;
+		};
+
+		std::vector<std::unique_ptr<carrier>> carriers;
+		std::vector<std::thread> threads;
+		std::atomic<unsigned int> next_carrier{ 0 };
+		std::atomic<bool> stopping{ false };
+
+		std::mutex stacks_mutex;
+		std::vector<char*> free_stacks; //stacks of ended fibers, mapped with their guard page
+
+		static constexpr size_t stack_size = 262144; //mapped lazily, a fiber touches a few pages
+
+		void Push(fiber* f);
+		void Done(latch& children);
+		void Start(fiber* f);
+		void Work(unsigned int self);
+
+		char* AllocateStack(void);
+		void FreeStack(char* stack);
+
+		static void Entry(void);
+		static void Stop(fiber* f, int request);
+	};
+}
+#endif
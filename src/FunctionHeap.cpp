@@ -2,53 +2,62 @@
 #include "DebugLogStream.h"
 #include "BrainThreadRuntimeException.h"
 
+#include <algorithm>
+
 namespace BT {
 
 	template < typename T >
-	FunctionHeap<T>::FunctionHeap() 
+	FunctionHeap<T>::FunctionHeap() : defined(0)
 	{
 	}
 
+	//threads get the functions, but not the call stack
 	template < typename T >
-	FunctionHeap<T>::FunctionHeap(const FunctionHeap<T>& fun)
+	FunctionHeap<T>::FunctionHeap(const FunctionHeap<T>& fun) : table(fun.table), slots(fun.slots), defined(fun.defined)
 	{
-		functions = fun.functions;
 	}
 
 	//add new function to list
 	template < typename T >
 	void FunctionHeap<T>::Add(T const& index, unsigned int const& code_ptr)
 	{
-		if (functions.find(index) != functions.end())
+		if (Find(index) != 0)
 			throw BFExistantFunctionException(index);  //funkcja istnieje
-	
-		functions[index] = code_ptr + 1;
-	}
 
-	//call function (move code pointer to function body and put old position on call stack)
-	template < typename T >
-	void FunctionHeap<T>::Call(T const& index, unsigned int* code_ptr)
-	{
-		if (functions.find(index) == functions.end())
-			throw BFUndefinedFunctionException(index);  //funkcja nie istnieje
-		else if (call_stack.size() > stack_limit)
-			throw BFFunctionStackOverflowException(); //stack overflow
+		++defined;
+		if constexpr (direct) {
+			if (table.empty())
+				table.resize(size_t(1) << (8 * sizeof(T)), 0);
+			table[static_cast<key_type>(index)] = code_ptr + 1;
+		}
+		else {
+			//at most half full, so a probe always ends on an empty slot
+			if (defined * 2 > slots.size())
+				Rehash(slots.empty() ? 16 : slots.size() * 2);
 
-		call_stack.push(std::make_pair(*code_ptr, index));
-		*code_ptr = functions[index];
+			const size_t mask = slots.size() - 1;
+			size_t i = Hash(index) & mask;
+			while (slots[i].second != 0)
+				i = (i + 1) & mask;
+			slots[i] = std::make_pair(index, code_ptr + 1);
+		}
 	}
 
-	//return a function - pop calling code position from call stack
 	template < typename T >
-	bool FunctionHeap<T>::Return(unsigned int* code_ptr)
+	void FunctionHeap<T>::Rehash(size_t size)
 	{
-		if (call_stack.empty() == false)
+		std::vector<std::pair<T, unsigned int>> old(size, std::make_pair(T(0), 0u));
+		old.swap(slots);
+
+		for (const auto& slot : old)
 		{
-			*code_ptr = call_stack.top().first;
-			call_stack.pop();
-			return true;
+			if (slot.second == 0)
+				continue;
+			size_t i = Hash(slot.first) & (size - 1);
+			while (slots[i].second != 0)
+				i = (i + 1) & (size - 1);
+			slots[i] = slot;
 		}
-		return false;
 	}
 
 	//call stack size
@@ -62,15 +71,12 @@ namespace BT {
 	template < typename T >
 	void FunctionHeap<T>::PrintStackTrace(std::ostream& s)
 	{
-		std::stack<std::pair<unsigned int, T>> call_stack_trace = call_stack;
-
 		s << "\n>Stack trace (" << Calls() << " " << ((Calls() > 1) ? "calls" : "call") << "):\n";
-		while (!call_stack_trace.empty())
+		for (auto it = call_stack.rbegin(); it != call_stack.rend(); ++it)
 		{
 			s << ">\tat function #";
-			PrintCellValue<T>(s, call_stack_trace.top().second);
-			s << " (call from position " << call_stack_trace.top().first << ")\n";
-			call_stack_trace.pop();
+			PrintCellValue<T>(s, it->second);
+			s << " (call from position " << it->first << ")\n";
 		}
 
 		s << std::flush;
@@ -79,12 +85,25 @@ namespace BT {
 	template < typename T >
 	void FunctionHeap<T>::PrintDeclaredFunctions(std::ostream& s)
 	{
-		s << "\n>List of already defined functions (" << functions.size() << ")";
-		for (typename std::map<T, unsigned int>::const_iterator mit = functions.begin(); mit != functions.end(); ++mit)
+		std::vector<std::pair<T, unsigned int>> list;
+		if constexpr (direct) {
+			for (size_t i = 0; i < table.size(); ++i)
+				if (table[i] != 0)
+					list.emplace_back(static_cast<T>(i), table[i]);
+		}
+		else {
+			for (const auto& slot : slots)
+				if (slot.second != 0)
+					list.push_back(slot);
+		}
+		std::sort(list.begin(), list.end());
+
+		s << "\n>List of already defined functions (" << defined << ")";
+		for (const auto& function : list)
 		{
 			s << "\n>Id: [";
-			PrintCellValue<T>(s, mit->first);
-			s << "] Start point: " << mit->second;
+			PrintCellValue<T>(s, function.first);
+			s << "] Start point: " << function.second;
 		}
 		s << std::endl;
 	}
@@ -1,20 +1,31 @@
 ﻿#pragma once
 
-#include <stack>
-#include <map>
+#include <vector>
 #include <ostream>
+#include <type_traits>
+
+#include "BrainThreadRuntimeException.h"
 
 namespace BT {
 
+	/*
+	 * Klasa FunctionHeap
+	 * 8 and 16 bit identifiers index a table directly, 32 bit ones go to an open addressing
+	 * hash table. Call and Return are defined below the class to be inlined into the engines.
+	*/
 	template < typename T >
 	class FunctionHeap
 	{
 	public:
 		FunctionHeap(void);
 		FunctionHeap(const FunctionHeap<T>& fun);
+		FunctionHeap(FunctionHeap<T>&& fun) = default;
 
 		void Add(T const& index, unsigned int const& code_ptr);
 		void Call(T const& index, unsigned int* code_ptr);
+		void Enter(T const& index, unsigned int body, unsigned int* code_ptr);
+		void TailCall(T const& index, unsigned int* code_ptr);
+		void TailEnter(T const& index, unsigned int body, unsigned int* code_ptr);
 		bool Return(unsigned int* code_ptr);
 
 		unsigned Calls(void) const;
@@ -23,12 +34,114 @@ namespace BT {
 		void PrintDeclaredFunctions(std::ostream& s);
 
 	protected:
-		std::map< T, unsigned int > functions;
-		//indeks funkcji, wskaźnik na kod, pierwszy po nawiasie
+		typedef typename std::make_unsigned<T>::type key_type;
+		static constexpr bool direct = sizeof(T) <= 2;
+
+		//wskaźnik na kod, pierwszy po nawiasie, 0 - funkcja nie istnieje
+		std::vector<unsigned int> table; //direct: indeks funkcji -> wskaźnik, allocated with the first function
+		std::vector<std::pair<T, unsigned int>> slots; //hash: indeks funkcji i wskaźnik
+		unsigned int defined;
 
-		std::stack< std::pair< unsigned int, T > > call_stack;
+		std::vector< std::pair< unsigned int, T > > call_stack;
 		//stos funkcji - zapisujemy wskaźnik oraz id funkcji, podczas wywolania funkcji
 
 		static constexpr unsigned int stack_limit = 65536;
+		static constexpr unsigned int stack_reserve = 64;
+
+		unsigned int Find(T const& index) const;
+		void Rehash(size_t size);
+		static size_t Hash(T const& index);
 	};
+
+	template < typename T >
+	inline size_t FunctionHeap<T>::Hash(T const& index)
+	{
+		unsigned int h = static_cast<key_type>(index);
+		h = (h ^ (h >> 16)) * 0x45d9f3bu;
+		return h ^ (h >> 16);
+	}
+
+	//start of the function body or 0
+	template < typename T >
+	inline unsigned int FunctionHeap<T>::Find(T const& index) const
+	{
+		if constexpr (direct) {
+			return table.empty() ? 0 : table[static_cast<key_type>(index)];
+		}
+		else {
+			if (slots.empty())
+				return 0;
+
+			const size_t mask = slots.size() - 1;
+			for (size_t i = Hash(index) & mask; ; i = (i + 1) & mask)
+			{
+				if (slots[i].second == 0 || slots[i].first == index)
+					return slots[i].second;
+			}
+		}
+	}
+
+	//call function (move code pointer to function body and put old position on call stack)
+	template < typename T >
+	inline void FunctionHeap<T>::Call(T const& index, unsigned int* code_ptr)
+	{
+		const unsigned int body = Find(index);
+
+		if (body == 0)
+			throw BFUndefinedFunctionException(index);  //funkcja nie istnieje
+
+		Enter(index, body, code_ptr);
+	}
+
+	//call of a function resolved by the analyser, the body is known
+	template < typename T >
+	inline void FunctionHeap<T>::Enter(T const& index, unsigned int body, unsigned int* code_ptr)
+	{
+		if (call_stack.size() > stack_limit)
+			throw BFFunctionStackOverflowException(); //stack overflow
+
+		if (call_stack.capacity() == 0)
+			call_stack.reserve(stack_reserve);
+
+		call_stack.emplace_back(*code_ptr, index);
+		*code_ptr = body;
+	}
+
+	//call right before the end of a function, the frame of the caller is reused
+	template < typename T >
+	inline void FunctionHeap<T>::TailCall(T const& index, unsigned int* code_ptr)
+	{
+		const unsigned int body = Find(index);
+
+		if (body == 0)
+			throw BFUndefinedFunctionException(index);  //funkcja nie istnieje
+
+		TailEnter(index, body, code_ptr);
+	}
+
+	//the caller returns to where it was called from, so only the id of the frame changes
+	template < typename T >
+	inline void FunctionHeap<T>::TailEnter(T const& index, unsigned int body, unsigned int* code_ptr)
+	{
+		if (call_stack.empty()) { //thread started inside the function, its end terminates the thread
+			Enter(index, body, code_ptr);
+			return;
+		}
+
+		call_stack.back().second = index;
+		*code_ptr = body;
+	}
+
+	//return a function - pop calling code position from call stack
+	template < typename T >
+	inline bool FunctionHeap<T>::Return(unsigned int* code_ptr)
+	{
+		if (call_stack.empty() == false)
+		{
+			*code_ptr = call_stack.back().first;
+			call_stack.pop_back();
+			return true;
+		}
+		return false;
+	}
 }
\ No newline at end of file
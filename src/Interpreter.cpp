@@ -1,29 +1,49 @@
 #include <iostream>
-
+#include <algorithm>
 
 #include "Interpreter.h"
 #include "BrainThreadRuntimeException.h"
 
 namespace BT {
 
-	template < typename T >
-	Interpreter<T>::Interpreter(mem_option mem_behavior, eof_option eof_behavior, unsigned int mem_size)
-		: InterpreterBase(mem_behavior, eof_behavior, mem_size)
+	template < typename T, mem_option M, eof_option E >
+	Interpreter<T, M, E>::Interpreter(unsigned int mem_size, engine_option engine, unsigned int yield_quantum, thread_option threads, bool blocking_heap)
+		: InterpreterBase(M, E, mem_size, engine, yield_quantum, threads, blocking_heap)
 	{
 	}
 
-	template < typename T >
-	void Interpreter<T>::Run(const CodeTape& tape)
+	template < typename T, mem_option M, eof_option E >
+	void Interpreter<T, M, E>::Run(const CodeTape& tape)
 	{
-		main_process = std::make_unique<BrainThreadProcess<T>>(tape, mem_size, mem_behavior, eof_behavior);
+		main_process = std::make_unique<BrainThreadProcess<T, M, E>>(tape, mem_size, engine, GetSchedulePolicy(tape));
 		main_process->Run();
 	}
 
+	//no forks - a single thread with nobody to give the time slice to
+	template < typename T, mem_option M, eof_option E >
+	schedule_policy Interpreter<T, M, E>::GetSchedulePolicy(const CodeTape& tape) const
+	{
+		schedule_policy policy;
+
+		if (std::any_of(tape.begin(), tape.end(), [](const bt_instruction& ins) { return ins.operation == bt_operation::btoFork; }))
+		{
+			policy.quantum = yield_quantum;
+			policy.at_back_edges = (yield_quantum == 0);
+			policy.threads = threads;
+			policy.blocking_heap = blocking_heap;
+#ifndef BT_FIBERS
+			if (threads == thread_option::toFiber)
+				policy.threads = thread_option::toSystem;
+#endif
+		}
+		return policy;
+	}
+
 	// Explicit template instantiation
-	template class Interpreter<char>;
-	template class Interpreter<unsigned char>;
-	template class Interpreter<unsigned short>;
-	template class Interpreter<unsigned int>;
-	template class Interpreter<short>;
-	template class Interpreter<int>;
+	BT_INSTANTIATE_BEHAVIORS(Interpreter, char)
+	BT_INSTANTIATE_BEHAVIORS(Interpreter, unsigned char)
+	BT_INSTANTIATE_BEHAVIORS(Interpreter, unsigned short)
+	BT_INSTANTIATE_BEHAVIORS(Interpreter, unsigned int)
+	BT_INSTANTIATE_BEHAVIORS(Interpreter, short)
+	BT_INSTANTIATE_BEHAVIORS(Interpreter, int)
 }
\ No newline at end of file
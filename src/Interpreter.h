@@ -11,24 +11,30 @@ namespace BT {
 		const mem_option mem_behavior; //tape memory behavior 
 		const eof_option eof_behavior; //input eof reaction setting
 		const unsigned int mem_size;
+		const engine_option engine; //instruction dispatch engine
+		const unsigned int yield_quantum; //instructions between thread yields, 0 - yield on loop back-edges
+		const thread_option threads; //what runs the forks
+		const bool blocking_heap; //~^ waits for a push
 
 	public:
-		InterpreterBase(mem_option mem_behavior, eof_option eof_behavior, unsigned int mem_size)
-			: mem_size(mem_size), mem_behavior(mem_behavior), eof_behavior(eof_behavior)
+		InterpreterBase(mem_option mem_behavior, eof_option eof_behavior, unsigned int mem_size, engine_option engine, unsigned int yield_quantum, thread_option threads, bool blocking_heap)
+			: mem_size(mem_size), mem_behavior(mem_behavior), eof_behavior(eof_behavior), engine(engine), yield_quantum(yield_quantum), threads(threads), blocking_heap(blocking_heap)
 		{}
 
 		virtual void Run(const CodeTape&) = 0;
 	};
 	
-	template < typename T >
+	template < typename T, mem_option M, eof_option E >
 	class Interpreter: public InterpreterBase
 	{	
 	public:
-		Interpreter(mem_option mem_behavior, eof_option eof_behavior, unsigned int mem_size);
+		Interpreter(unsigned int mem_size, engine_option engine, unsigned int yield_quantum, thread_option threads, bool blocking_heap);
 
 		void Run(const CodeTape &);
 
 	protected:
-		std::unique_ptr<BrainThreadProcess<T>> main_process;
+		std::unique_ptr<BrainThreadProcess<T, M, E>> main_process;
+
+		schedule_policy GetSchedulePolicy(const CodeTape &) const;
 	};
 }
\ No newline at end of file
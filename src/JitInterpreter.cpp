@@ -0,0 +1,521 @@
+#include <iostream>
+#include <cstring>
+
+#include "JitInterpreter.h"
+#include "MessageLog.h"
+#include "BrainThreadRuntimeException.h"
+
+#ifdef BT_JIT_X64
+ #include <sys/mman.h>
+#endif
+
+namespace BT {
+
+	template < typename T, mem_option M, eof_option E >
+	JitInterpreter<T, M, E>::JitInterpreter(unsigned int mem_size, unsigned int yield_quantum, thread_option threads, bool blocking_heap)
+		: InterpreterBase(M, E, mem_size, engine_option::enJit, yield_quantum, threads, blocking_heap), code_buffer(nullptr), code_size(0)
+	{
+	}
+
+	template < typename T, mem_option M, eof_option E >
+	JitInterpreter<T, M, E>::~JitInterpreter()
+	{
+#ifdef BT_JIT_X64
+		if (code_buffer)
+			munmap(code_buffer, code_size);
+#endif
+	}
+
+	template < typename T, mem_option M, eof_option E >
+	void JitInterpreter<T, M, E>::Run(const CodeTape& tape)
+	{
+		if (IsCompilable(tape))
+		{
+			try {
+				memory = std::make_unique<MemoryTape<T, M, E>>(mem_size);
+				if (Compile(tape)) {
+					Execute();
+					return;
+				}
+			}
+			catch (const BrainThreadRuntimeException& re) {
+				std::cerr << "<t" << std::this_thread::get_id() << "> " << re.what() << std::endl;
+				return;
+			}
+			catch (const std::exception& e) {
+				std::cerr << "<t" << std::this_thread::get_id() << "> " << e.what() << std::endl;
+				return;
+			}
+		}
+
+		MessageLog::Instance().AddInfo("JIT cannot compile this code, running the interpreter");
+		Interpreter<T, M, E>(mem_size, engine_option::enThreaded, yield_quantum, threads, blocking_heap).Run(tape);
+	}
+
+	//threads, functions, the shared heap and debug instructions are left to the interpreter
+	template < typename T, mem_option M, eof_option E >
+	bool JitInterpreter<T, M, E>::IsCompilable(const CodeTape& tape)
+	{
+		for (const bt_instruction& ins : tape)
+		{
+			switch (ins.operation)
+			{
+			case bt_operation::btoIncrement:
+			case bt_operation::btoDecrement:
+			case bt_operation::btoMoveLeft:
+			case bt_operation::btoMoveRight:
+			case bt_operation::btoOPT_Increment:
+			case bt_operation::btoOPT_Decrement:
+			case bt_operation::btoOPT_MoveLeft:
+			case bt_operation::btoOPT_MoveRight:
+			case bt_operation::btoOPT_SetCellToZero:
+			case bt_operation::btoOPT_MulAdd:
+			case bt_operation::btoOPT_MulSub:
+			case bt_operation::btoOPT_ScanRight:
+			case bt_operation::btoOPT_ScanLeft:
+			case bt_operation::btoOPT_NoOperation:
+			case bt_operation::btoAsciiRead:
+			case bt_operation::btoAsciiWrite:
+			case bt_operation::btoDecimalRead:
+			case bt_operation::btoDecimalWrite:
+			case bt_operation::btoBeginLoop:
+			case bt_operation::btoEndLoop:
+			case bt_operation::btoPush:
+			case bt_operation::btoPop:
+			case bt_operation::btoSwap:
+			case bt_operation::btoOPT_PushRun:
+			case bt_operation::btoOPT_PopRun:
+			case bt_operation::btoTerminate:
+			case bt_operation::btoEndProgram:
+				break;
+			default:
+				return false;
+			}
+		}
+		return true;
+	}
+
+	template < typename T, mem_option M, eof_option E >
+	bool JitInterpreter<T, M, E>::Compile(const CodeTape& tape)
+	{
+#ifdef BT_JIT_X64
+#ifdef BT_GUARD_PAGES
+		X64Emitter x64(sizeof(T), memory->IsGuarded() ? MemoryTape<T, M, E>::guard_size : 0);
+#else
+		X64Emitter x64(sizeof(T));
+#endif
+		const void* const reach = reinterpret_cast<const void*>(&ReachHelper);
+
+		x64.Prologue();
+		for (const bt_instruction& ins : tape)
+		{
+			switch (ins.operation)
+			{
+			case bt_operation::btoIncrement: x64.AddCell(1, 0, reach); break;
+			case bt_operation::btoDecrement: x64.AddCell(-1, 0, reach); break;
+			case bt_operation::btoOPT_Increment: x64.AddCell(ins.repetitions, ins.offset, reach); break;
+			case bt_operation::btoOPT_Decrement: x64.AddCell(-ins.repetitions, ins.offset, reach); break;
+			case bt_operation::btoOPT_SetCellToZero: x64.SetCell(0, ins.offset, reach); break;
+			case bt_operation::btoOPT_MulAdd:
+			case bt_operation::btoOPT_MulSub:
+				mul_operands.emplace_back(ins.offset, ins.operation == bt_operation::btoOPT_MulAdd ? ins.repetitions : -ins.repetitions);
+				x64.MulAdd(mul_operands.back().first, mul_operands.back().second, reinterpret_cast<const void*>(&Helper<&MulAdd>), static_cast<unsigned int>(mul_operands.size() - 1));
+				break;
+
+			case bt_operation::btoMoveRight: x64.MoveRight(1, reinterpret_cast<const void*>(&Helper<&MoveRight>)); break;
+			case bt_operation::btoMoveLeft: x64.MoveLeft(1, reinterpret_cast<const void*>(&Helper<&MoveLeft>)); break;
+			case bt_operation::btoOPT_MoveRight: x64.MoveRight(ins.repetitions, reinterpret_cast<const void*>(&Helper<&MoveRight>)); break;
+			case bt_operation::btoOPT_MoveLeft: x64.MoveLeft(ins.repetitions, reinterpret_cast<const void*>(&Helper<&MoveLeft>)); break;
+
+			case bt_operation::btoOPT_ScanRight: x64.CallHelper(reinterpret_cast<const void*>(&Helper<&ScanRight>), ins.repetitions); break;
+			case bt_operation::btoOPT_ScanLeft: x64.CallHelper(reinterpret_cast<const void*>(&Helper<&ScanLeft>), ins.repetitions); break;
+
+			case bt_operation::btoAsciiWrite: x64.CallHelper(reinterpret_cast<const void*>(&Helper<&Write>), ins.offset); break;
+			case bt_operation::btoAsciiRead: x64.CallHelper(reinterpret_cast<const void*>(&Helper<&Read>), ins.offset); break;
+			case bt_operation::btoDecimalWrite: x64.CallHelper(reinterpret_cast<const void*>(&Helper<&DecimalWrite>), ins.offset); break;
+			case bt_operation::btoDecimalRead: x64.CallHelper(reinterpret_cast<const void*>(&Helper<&DecimalRead>), ins.offset); break;
+			case bt_operation::btoPush: x64.CallHelper(reinterpret_cast<const void*>(&Helper<&Push>), 0); break;
+			case bt_operation::btoPop: x64.CallHelper(reinterpret_cast<const void*>(&Helper<&Pop>), 0); break;
+			case bt_operation::btoSwap: x64.CallHelper(reinterpret_cast<const void*>(&Helper<&Swap>), 0); break;
+			case bt_operation::btoOPT_PushRun: x64.CallHelper(reinterpret_cast<const void*>(&Helper<&PushRun>), ins.offset); break;
+			case bt_operation::btoOPT_PopRun: x64.CallHelper(reinterpret_cast<const void*>(&Helper<&PopRun>), ins.offset); break;
+
+			case bt_operation::btoBeginLoop: x64.BeginLoop(); break;
+			case bt_operation::btoEndLoop: x64.EndLoop(); break;
+
+			case bt_operation::btoTerminate:
+			case bt_operation::btoEndProgram: x64.Epilogue(); break;
+			default: break;
+			}
+		}
+		x64.ErrorEpilogue();
+
+		if (x64.IsBalanced() == false)
+			return false;
+
+		const std::vector<unsigned char>& bin = x64.GetCode();
+		void* buffer = mmap(nullptr, bin.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (buffer == MAP_FAILED)
+			return false;
+
+		std::memcpy(buffer, bin.data(), bin.size());
+		if (mprotect(buffer, bin.size(), PROT_READ | PROT_EXEC) != 0)
+		{
+			munmap(buffer, bin.size());
+			return false;
+		}
+
+		code_buffer = buffer;
+		code_size = bin.size();
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	template < typename T, mem_option M, eof_option E >
+	void JitInterpreter<T, M, E>::Execute()
+	{
+		jit_state state{ memory->mem, memory->max_mem, this, memory->pointer };
+		jit_function fn = reinterpret_cast<jit_function>(code_buffer);
+
+#ifdef BT_GUARD_PAGES
+		//the compiled code does not compare right moves on a guarded tape, a fault in a guard ends here
+		sigjmp_buf fault;
+		if (memory->IsGuarded()) {
+			if (const int side = sigsetjmp(fault, 1)) {
+				MemoryTape<T, M, E>::DisarmGuard();
+				throw BFRangeException(side == 1 ? -1 : memory->len);
+			}
+			memory->ArmGuard(&fault);
+		}
+		T* p = fn(&state, memory->pointer);
+		MemoryTape<T, M, E>::DisarmGuard();
+#else
+		T* p = fn(&state, memory->pointer);
+#endif
+		if (p == nullptr)
+			std::rethrow_exception(error);
+
+		memory->pointer = p;
+	}
+
+	//runs the operation on the tape and reports the new memory bounds to the compiled code
+	//exceptions cannot pass through the compiled code, so they are kept and rethrown by Execute
+	template < typename T, mem_option M, eof_option E >
+	template < void (*Op)(JitInterpreter<T, M, E>&, unsigned int) >
+	T* JitInterpreter<T, M, E>::Helper(jit_state* state, T* p, unsigned int n)
+	{
+		JitInterpreter<T, M, E>& jit = *state->owner;
+		try {
+			jit.memory->pointer = p;
+			Op(jit, n);
+
+			state->lo = jit.memory->mem;
+			state->hi = jit.memory->max_mem;
+			return jit.memory->pointer;
+		}
+		catch (...) {
+			jit.error = std::current_exception();
+			return nullptr;
+		}
+	}
+
+	//returns the cell at offset n instead of the pointer, the pointer is left in the state
+	template < typename T, mem_option M, eof_option E >
+	T* JitInterpreter<T, M, E>::ReachHelper(jit_state* state, T* p, unsigned int n)
+	{
+		JitInterpreter<T, M, E>& jit = *state->owner;
+		try {
+			jit.memory->pointer = p;
+			T* const cell = jit.memory->Reach(static_cast<int>(n));
+
+			state->lo = jit.memory->mem;
+			state->hi = jit.memory->max_mem;
+			state->p = jit.memory->pointer;
+			return cell;
+		}
+		catch (...) {
+			jit.error = std::current_exception();
+			return nullptr;
+		}
+	}
+
+	template < typename T, mem_option M, eof_option E >
+	void JitInterpreter<T, M, E>::MoveRight(JitInterpreter<T, M, E>& jit, unsigned int n) { jit.memory->MoveRight(n); }
+	template < typename T, mem_option M, eof_option E >
+	void JitInterpreter<T, M, E>::MoveLeft(JitInterpreter<T, M, E>& jit, unsigned int n) { jit.memory->MoveLeft(n); }
+	template < typename T, mem_option M, eof_option E >
+	void JitInterpreter<T, M, E>::Write(JitInterpreter<T, M, E>& jit, unsigned int n) { jit.memory->Write(static_cast<int>(n)); }
+	template < typename T, mem_option M, eof_option E >
+	void JitInterpreter<T, M, E>::Read(JitInterpreter<T, M, E>& jit, unsigned int n) { jit.memory->Read(static_cast<int>(n)); }
+	template < typename T, mem_option M, eof_option E >
+	void JitInterpreter<T, M, E>::DecimalWrite(JitInterpreter<T, M, E>& jit, unsigned int n) { jit.memory->DecimalWrite(static_cast<int>(n)); }
+	template < typename T, mem_option M, eof_option E >
+	void JitInterpreter<T, M, E>::DecimalRead(JitInterpreter<T, M, E>& jit, unsigned int n) { jit.memory->DecimalRead(static_cast<int>(n)); }
+	template < typename T, mem_option M, eof_option E >
+	void JitInterpreter<T, M, E>::Push(JitInterpreter<T, M, E>& jit, unsigned int) { jit.heap.Push(*jit.memory->GetValue()); }
+	template < typename T, mem_option M, eof_option E >
+	void JitInterpreter<T, M, E>::Pop(JitInterpreter<T, M, E>& jit, unsigned int) { *jit.memory->GetValue() = jit.heap.Pop(); }
+	template < typename T, mem_option M, eof_option E >
+	void JitInterpreter<T, M, E>::Swap(JitInterpreter<T, M, E>& jit, unsigned int) { jit.heap.Swap(); }
+	template < typename T, mem_option M, eof_option E >
+	void JitInterpreter<T, M, E>::PushRun(JitInterpreter<T, M, E>& jit, unsigned int n) { jit.heap.PushRun(*jit.memory, static_cast<int>(n)); }
+	template < typename T, mem_option M, eof_option E >
+	void JitInterpreter<T, M, E>::PopRun(JitInterpreter<T, M, E>& jit, unsigned int n) { jit.heap.PopRun(*jit.memory, static_cast<int>(n)); }
+	template < typename T, mem_option M, eof_option E >
+	void JitInterpreter<T, M, E>::MulAdd(JitInterpreter<T, M, E>& jit, unsigned int n) { jit.memory->MulAdd(jit.mul_operands[n].first, jit.mul_operands[n].second); }
+	template < typename T, mem_option M, eof_option E >
+	void JitInterpreter<T, M, E>::ScanRight(JitInterpreter<T, M, E>& jit, unsigned int n) { jit.memory->ScanRight(n); }
+	template < typename T, mem_option M, eof_option E >
+	void JitInterpreter<T, M, E>::ScanLeft(JitInterpreter<T, M, E>& jit, unsigned int n) { jit.memory->ScanLeft(n); }
+
+	/*
+	 * X64Emitter
+	*/
+	void X64Emitter::Prologue()
+	{
+		Emit({ 0x53 });					//push rbx
+		Emit({ 0x41, 0x54 });			//push r12
+		Emit({ 0x41, 0x55 });			//push r13
+		Emit({ 0x41, 0x56 });			//push r14
+		Emit({ 0x41, 0x57 });			//push r15 (keeps the stack aligned for calls)
+		Emit({ 0x49, 0x89, 0xFC });		//mov r12, rdi
+		Emit({ 0x48, 0x89, 0xF3 });		//mov rbx, rsi
+		ReloadBounds();
+	}
+
+	void X64Emitter::Epilogue()
+	{
+		Emit({ 0x48, 0x89, 0xD8 });		//mov rax, rbx
+		Emit({ 0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5B }); //pop r15, r14, r13, r12, rbx
+		Emit({ 0xC3 });					//ret
+	}
+
+	void X64Emitter::ErrorEpilogue()
+	{
+		for (size_t pos : error_jumps)
+			Patch32(pos, code.size());
+
+		Emit({ 0x31, 0xC0 });			//xor eax, eax
+		Emit({ 0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5B });
+		Emit({ 0xC3 });
+	}
+
+	//cells at an offset are addressed by rax
+	void X64Emitter::AddCell(int amount, int offset, const void* helper)
+	{
+		const unsigned char cell = offset ? CellAddress(offset, helper) : 0x03;
+		switch (cell_size)
+		{
+		case 1: Emit({ 0x80, cell, static_cast<unsigned char>(amount) }); break;	//add byte [rbx], imm8
+		case 2: Emit({ 0x66, 0x81, cell, static_cast<unsigned char>(amount), static_cast<unsigned char>(amount >> 8) }); break;
+		default: Emit({ 0x81, cell }); Emit32(amount);
+		}
+	}
+
+	void X64Emitter::SetCell(int value, int offset, const void* helper)
+	{
+		const unsigned char cell = offset ? CellAddress(offset, helper) : 0x03;
+		switch (cell_size)
+		{
+		case 1: Emit({ 0xC6, cell, static_cast<unsigned char>(value) }); break;	//mov byte [rbx], imm8
+		case 2: Emit({ 0x66, 0xC7, cell, static_cast<unsigned char>(value), static_cast<unsigned char>(value >> 8) }); break;
+		default: Emit({ 0xC7, cell }); Emit32(value);
+		}
+	}
+
+	//rax = cell at offset, out of the tape the helper reaches it (wrap, realloc or error); returns ModRM of [rax]
+	unsigned char X64Emitter::CellAddress(int offset, const void* helper)
+	{
+		Emit({ 0x48, 0x8D, 0x83 }); Emit32(offset * static_cast<int>(cell_size));	//lea rax, [rbx + offset]
+		if (offset > 0 && static_cast<unsigned long long>(offset) * cell_size < guard)
+			return 0x00; //the access itself faults past the tape
+
+		Emit({ 0x4C, 0x39, 0xE8 });		//cmp rax, r13
+		Emit({ 0x72, 0x00 });			//jb slow
+		size_t below = code.size();
+		Emit({ 0x4C, 0x39, 0xF0 });		//cmp rax, r14
+		Emit({ 0x76, 0x00 });			//jbe done
+		size_t inside = code.size();
+
+		code[below - 1] = static_cast<unsigned char>(code.size() - below);
+		Emit({ 0x4C, 0x89, 0xE7 });		//slow: mov rdi, r12
+		Emit({ 0x48, 0x89, 0xDE });		//mov rsi, rbx
+		Emit({ 0xBA }); Emit32(offset);	//mov edx, offset
+		Emit({ 0x48, 0xB8 }); Emit64(reinterpret_cast<unsigned long long>(helper)); //mov rax, helper
+		Emit({ 0xFF, 0xD0 });			//call rax
+		Emit({ 0x48, 0x85, 0xC0 });		//test rax, rax
+		Emit({ 0x0F, 0x84 });			//jz error
+		error_jumps.push_back(code.size());
+		Emit32(0);
+		Emit({ 0x49, 0x8B, 0x5C, 0x24, 0x18 });	//mov rbx, [r12 + 24]
+		ReloadBounds();
+
+		code[inside - 1] = static_cast<unsigned char>(code.size() - inside);
+		return 0x00;
+	}
+
+	void X64Emitter::CompareCellToZero()
+	{
+		switch (cell_size)
+		{
+		case 1: Emit({ 0x80, 0x3B, 0x00 }); break;			//cmp byte [rbx], 0
+		case 2: Emit({ 0x66, 0x83, 0x3B, 0x00 }); break;	//cmp word [rbx], 0
+		default: Emit({ 0x83, 0x3B, 0x00 });				//cmp dword [rbx], 0
+		}
+	}
+
+	//fast path stays inline, leaving the tape goes to the helper (wrap, realloc or error)
+	void X64Emitter::MoveRight(unsigned int n, const void* helper)
+	{
+		if (n * cell_size < guard) {
+			Emit({ 0x48, 0x81, 0xC3 }); Emit32(n * cell_size);	//add rbx, n
+			Emit({ 0x80, 0x3B, 0x00 });							//cmp byte [rbx], 0 - faults in the guard
+			return;
+		}
+
+		Emit({ 0x48, 0x8D, 0x83 }); Emit32(n * cell_size);	//lea rax, [rbx + n]
+		Emit({ 0x4C, 0x39, 0xF0 });							//cmp rax, r14
+		Emit({ 0x76, 0x00 });								//jbe fast
+		size_t fast = code.size();
+
+		CallHelper(helper, n);
+		Emit({ 0xEB, 0x00 });								//jmp done
+		size_t done = code.size();
+
+		code[fast - 1] = static_cast<unsigned char>(code.size() - fast);
+		Emit({ 0x48, 0x89, 0xC3 });							//fast: mov rbx, rax
+		code[done - 1] = static_cast<unsigned char>(code.size() - done);
+	}
+
+	void X64Emitter::MoveLeft(unsigned int n, const void* helper)
+	{
+		Emit({ 0x48, 0x8D, 0x83 }); Emit32(0u - n * cell_size);	//lea rax, [rbx - n]
+		Emit({ 0x4C, 0x39, 0xE8 });							//cmp rax, r13
+		Emit({ 0x73, 0x00 });								//jae fast
+		size_t fast = code.size();
+
+		CallHelper(helper, n);
+		Emit({ 0xEB, 0x00 });								//jmp done
+		size_t done = code.size();
+
+		code[fast - 1] = static_cast<unsigned char>(code.size() - fast);
+		Emit({ 0x48, 0x89, 0xC3 });							//fast: mov rbx, rax
+		code[done - 1] = static_cast<unsigned char>(code.size() - done);
+	}
+
+	//cell[offset] += cell * factor, a target out of the tape goes to the helper
+	void X64Emitter::MulAdd(int offset, int factor, const void* helper, unsigned int n)
+	{
+		CompareCellToZero();
+		Emit({ 0x0F, 0x84 });								//je skip
+		size_t skip = code.size();
+		Emit32(0);
+
+		Emit({ 0x48, 0x8D, 0x83 }); Emit32(offset * static_cast<int>(cell_size));	//lea rax, [rbx + offset]
+		Emit({ 0x4C, 0x39, 0xE8 });							//cmp rax, r13
+		Emit({ 0x72, 0x00 });								//jb slow
+		size_t below = code.size();
+		Emit({ 0x4C, 0x39, 0xF0 });							//cmp rax, r14
+		Emit({ 0x77, 0x00 });								//ja slow
+		size_t above = code.size();
+
+		switch (cell_size)
+		{
+		case 1: Emit({ 0x0F, 0xB6, 0x0B }); break;			//movzx ecx, byte [rbx]
+		case 2: Emit({ 0x0F, 0xB7, 0x0B }); break;			//movzx ecx, word [rbx]
+		default: Emit({ 0x8B, 0x0B });						//mov ecx, [rbx]
+		}
+		Emit({ 0x69, 0xC9 }); Emit32(factor);				//imul ecx, ecx, factor
+		switch (cell_size)
+		{
+		case 1: Emit({ 0x00, 0x08 }); break;				//add [rax], cl
+		case 2: Emit({ 0x66, 0x01, 0x08 }); break;			//add [rax], cx
+		default: Emit({ 0x01, 0x08 });						//add [rax], ecx
+		}
+		Emit({ 0xEB, 0x00 });								//jmp done
+		size_t done = code.size();
+
+		code[below - 1] = static_cast<unsigned char>(code.size() - below);
+		code[above - 1] = static_cast<unsigned char>(code.size() - above);
+		CallHelper(helper, n);								//slow:
+
+		code[done - 1] = static_cast<unsigned char>(code.size() - done);
+		Patch32(skip, code.size());
+	}
+
+	//helper(state, pointer, n) returns the new pointer or null on error
+	void X64Emitter::CallHelper(const void* helper, unsigned int n)
+	{
+		Emit({ 0x4C, 0x89, 0xE7 });		//mov rdi, r12
+		Emit({ 0x48, 0x89, 0xDE });		//mov rsi, rbx
+		Emit({ 0xBA }); Emit32(n);		//mov edx, n
+		Emit({ 0x48, 0xB8 }); Emit64(reinterpret_cast<unsigned long long>(helper)); //mov rax, helper
+		Emit({ 0xFF, 0xD0 });			//call rax
+		Emit({ 0x48, 0x85, 0xC0 });		//test rax, rax
+		Emit({ 0x0F, 0x84 });			//jz error
+		error_jumps.push_back(code.size());
+		Emit32(0);
+		Emit({ 0x48, 0x89, 0xC3 });		//mov rbx, rax
+		ReloadBounds();
+	}
+
+	void X64Emitter::BeginLoop()
+	{
+		CompareCellToZero();
+		Emit({ 0x0F, 0x84 });			//je past the loop
+		loops.push_back(code.size());
+		Emit32(0);
+	}
+
+	void X64Emitter::EndLoop()
+	{
+		size_t begin = loops.back();
+		loops.pop_back();
+
+		CompareCellToZero();
+		Emit({ 0x0F, 0x85 });			//jne loop body
+		Emit32(0);
+		Patch32(code.size() - 4, begin + 4);
+		Patch32(begin, code.size());
+	}
+
+	void X64Emitter::ReloadBounds()
+	{
+		Emit({ 0x4D, 0x8B, 0x2C, 0x24 });		//mov r13, [r12]
+		Emit({ 0x4D, 0x8B, 0x74, 0x24, 0x08 });	//mov r14, [r12 + 8]
+	}
+
+	void X64Emitter::Emit(std::initializer_list<unsigned char> bytes)
+	{
+		code.insert(code.end(), bytes);
+	}
+
+	void X64Emitter::Emit32(unsigned int v)
+	{
+		for (int i = 0; i < 4; ++i)
+			code.push_back(static_cast<unsigned char>(v >> (8 * i)));
+	}
+
+	void X64Emitter::Emit64(unsigned long long v)
+	{
+		for (int i = 0; i < 8; ++i)
+			code.push_back(static_cast<unsigned char>(v >> (8 * i)));
+	}
+
+	void X64Emitter::Patch32(size_t pos, size_t target)
+	{
+		unsigned int rel = static_cast<unsigned int>(target - (pos + 4));
+		for (int i = 0; i < 4; ++i)
+			code[pos + i] = static_cast<unsigned char>(rel >> (8 * i));
+	}
+
+	// Explicit template instantiation
+	BT_INSTANTIATE_BEHAVIORS(JitInterpreter, char)
+	BT_INSTANTIATE_BEHAVIORS(JitInterpreter, unsigned char)
+	BT_INSTANTIATE_BEHAVIORS(JitInterpreter, unsigned short)
+	BT_INSTANTIATE_BEHAVIORS(JitInterpreter, unsigned int)
+	BT_INSTANTIATE_BEHAVIORS(JitInterpreter, short)
+	BT_INSTANTIATE_BEHAVIORS(JitInterpreter, int)
+}
\ No newline at end of file
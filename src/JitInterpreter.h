@@ -0,0 +1,119 @@
+#pragma once
+
+#include <vector>
+#include <exception>
+
+#include "Interpreter.h"
+
+#if defined(__x86_64__) && (defined(__unix__) || defined(__APPLE__))
+	#define BT_JIT_X64
+#endif
+
+namespace BT {
+
+	/*
+	 * Klasa JitInterpreter
+	 * Compiles the code tape to x86-64 machine code in an executable buffer and runs it.
+	 * Forks, functions, the shared heap and debug instructions are not compiled yet,
+	 * such code is passed to the regular Interpreter.
+	*/
+	template < typename T, mem_option M, eof_option E >
+	class JitInterpreter : public InterpreterBase
+	{
+	public:
+		JitInterpreter(unsigned int mem_size, unsigned int yield_quantum, thread_option threads, bool blocking_heap);
+		~JitInterpreter();
+
+		void Run(const CodeTape &);
+
+		static bool IsCompilable(const CodeTape &);
+
+	protected:
+		//state shared with the compiled code, lo and hi are reloaded after every helper call
+		struct jit_state
+		{
+			T* lo;
+			T* hi;
+			JitInterpreter<T, M, E>* owner;
+			T* p; //pointer after ReachHelper
+		};
+
+		typedef T* (*jit_function)(jit_state*, T*);
+		typedef T* (*jit_helper)(jit_state*, T*, unsigned int);
+
+		std::unique_ptr<MemoryTape<T, M, E>> memory;
+		MemoryHeap<T> heap;
+		std::exception_ptr error;
+		std::vector<std::pair<int, int>> mul_operands; //offset and factor of every MulAdd, the helper gets the index
+
+		void* code_buffer;
+		size_t code_size;
+
+		bool Compile(const CodeTape &);
+		void Execute();
+
+		//slow paths called from the compiled code
+		template < void (*Op)(JitInterpreter<T, M, E>&, unsigned int) >
+		static T* Helper(jit_state* state, T* p, unsigned int n);
+
+		static T* ReachHelper(jit_state* state, T* p, unsigned int n);
+		static void MoveRight(JitInterpreter<T, M, E>& jit, unsigned int n);
+		static void MoveLeft(JitInterpreter<T, M, E>& jit, unsigned int n);
+		static void Write(JitInterpreter<T, M, E>& jit, unsigned int n);
+		static void Read(JitInterpreter<T, M, E>& jit, unsigned int n);
+		static void DecimalWrite(JitInterpreter<T, M, E>& jit, unsigned int n);
+		static void DecimalRead(JitInterpreter<T, M, E>& jit, unsigned int n);
+		static void Push(JitInterpreter<T, M, E>& jit, unsigned int n);
+		static void Pop(JitInterpreter<T, M, E>& jit, unsigned int n);
+		static void Swap(JitInterpreter<T, M, E>& jit, unsigned int n);
+		static void PushRun(JitInterpreter<T, M, E>& jit, unsigned int n);
+		static void PopRun(JitInterpreter<T, M, E>& jit, unsigned int n);
+		static void MulAdd(JitInterpreter<T, M, E>& jit, unsigned int n);
+		static void ScanRight(JitInterpreter<T, M, E>& jit, unsigned int n);
+		static void ScanLeft(JitInterpreter<T, M, E>& jit, unsigned int n);
+	};
+
+	/*
+	 * x86-64 machine code emitter used by the JIT.
+	 * Registers: rbx - cell pointer, r12 - jit_state, r13 - first cell, r14 - last cell
+	 * With a guarded tape moves to the right only touch the new cell, the guard catches the overrun.
+	*/
+	class X64Emitter
+	{
+	public:
+		X64Emitter(unsigned cell_size, unsigned int guard = 0) : cell_size(cell_size), guard(guard) {}
+
+		void Prologue();
+		void Epilogue();
+		void ErrorEpilogue();
+
+		void AddCell(int amount, int offset, const void* helper);
+		void SetCell(int value, int offset, const void* helper);
+		void MoveRight(unsigned int n, const void* helper);
+		void MoveLeft(unsigned int n, const void* helper);
+		void MulAdd(int offset, int factor, const void* helper, unsigned int n);
+		void CallHelper(const void* helper, unsigned int n);
+
+		void BeginLoop();
+		void EndLoop();
+
+		bool IsBalanced() const { return loops.empty(); }
+		const std::vector<unsigned char>& GetCode() const { return code; }
+
+	protected:
+		const unsigned cell_size;
+		const unsigned int guard; //bytes after the last cell which fault instead of being compared, 0 - none
+
+		std::vector<unsigned char> code;
+		std::vector<size_t> loops; //positions of the rel32 of loop entry jumps
+		std::vector<size_t> error_jumps; //positions of the rel32 of jumps to the error exit
+
+		void Emit(std::initializer_list<unsigned char> bytes);
+		void Emit32(unsigned int v);
+		void Emit64(unsigned long long v);
+		void CompareCellToZero();
+		unsigned char CellAddress(int offset, const void* helper);
+		void Patch32(size_t pos, size_t target);
+		void ReloadBounds();
+	};
+}
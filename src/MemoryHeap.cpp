@@ -4,61 +4,14 @@
 
 namespace BT {
 
-	//Funkcja odkada warto na stos. Limit = stack_limit
-	template <typename T>
-	void MemoryHeap<T>::Push(const T& n)
-	{
-		if (mem_stack.size() > stack_limit)
-			throw BFMemoryStackOverflowException();
-
-		mem_stack.push(n);
-	}
-
-	//Funkcja zdejmuje i zwraca warto ze stosu. Gdy stos jest pusty, zwraca zero
-	template <typename T>
-	T MemoryHeap<T>::Pop(void)
-	{
-		if (mem_stack.empty())
-			return 0;
-
-		T tmp;
-		tmp = mem_stack.top();
-		mem_stack.pop();
-
-		return tmp;
-	}
-
-	//Funkcja zamienia szczytowe dwie waroci ze sob. 
-	//Gdy stos ma mniej ni 2 elementy, nic si nie dzieje.
-	template <typename T>
-	void MemoryHeap<T>::Swap(void)
-	{
-		if (mem_stack.size() < 2)
-			return;
-
-		T tmp, tmp2;
-
-		tmp = mem_stack.top();
-		mem_stack.pop();
-
-		tmp2 = mem_stack.top();
-		mem_stack.pop();
-
-		mem_stack.push(tmp);
-		mem_stack.push(tmp2);
-	}
-
 	template < typename T >
 	void MemoryHeap<T>::PrintStack(std::ostream& s)
 	{
-		std::stack<T> st = mem_stack;
-
-		s << "\n>Memory stack (fifo, " << st.size() << ")\n";
-		while (!st.empty())
+		s << "\n>Memory stack (fifo, " << mem_stack.size() << ")\n";
+		for (auto it = mem_stack.rbegin(); it != mem_stack.rend(); ++it)
 		{
-			PrintCellValue<T>(s, st.top());
-			st.pop();
-			s << (st.empty() ? '\n' : ',');
+			PrintCellValue<T>(s, *it);
+			s << (it + 1 == mem_stack.rend() ? '\n' : ',');
 		}
 		s << std::flush;
 	}
@@ -1,12 +1,18 @@
 #pragma once
 
-#include <stack>
+#include <vector>
+#include <cstdlib>
 #include <ostream>
+#include <algorithm>
+
+#include "BrainThreadRuntimeException.h"
 
 /*
  * Klasa Stosu Pamici.
  * Peni rol pomocnicz dla tamy pamici. Dotatkowo pozwala zamienia
  * ze sob dwie ostatnie wartoci. Wielkoc stosu ogranicza zmienna 'stack_limit'.
+ * Cells are kept in a vector, the top is the back. Push, Pop, Swap and the runs
+ * are defined below the class to be inlined into the engines.
 */
 
 namespace BT {
@@ -21,11 +27,131 @@ namespace BT {
 		T Pop(void);
 		void Swap(void);
 
+		void Push(const T* cells, int step, unsigned int n);
+		void Pop(T* cells, int step, unsigned int n);
+
+		template < typename Tape >
+		void PushRun(Tape& memory, int last);
+		template < typename Tape >
+		void PopRun(Tape& memory, int last);
+
 		void PrintStack(std::ostream& s);
 
 	protected:
-		std::stack<T> mem_stack;
+		std::vector<T> mem_stack;
 
 		static const unsigned int stack_limit = 65536;
+		static const unsigned int stack_reserve = 64;
 	};
+
+	//Funkcja odkada warto na stos. Limit = stack_limit
+	template < typename T >
+	inline void MemoryHeap<T>::Push(const T& n)
+	{
+		if (mem_stack.size() > stack_limit)
+			throw BFMemoryStackOverflowException();
+
+		if (mem_stack.capacity() == 0)
+			mem_stack.reserve(stack_reserve);
+
+		mem_stack.push_back(n);
+	}
+
+	//Funkcja zdejmuje i zwraca warto ze stosu. Gdy stos jest pusty, zwraca zero
+	template < typename T >
+	inline T MemoryHeap<T>::Pop(void)
+	{
+		if (mem_stack.empty())
+			return 0;
+
+		const T tmp = mem_stack.back();
+		mem_stack.pop_back();
+		return tmp;
+	}
+
+	//Funkcja zamienia szczytowe dwie waroci ze sob.
+	//Gdy stos ma mniej ni 2 elementy, nic si nie dzieje.
+	template < typename T >
+	inline void MemoryHeap<T>::Swap(void)
+	{
+		const size_t size = mem_stack.size();
+		if (size < 2)
+			return;
+
+		std::swap(mem_stack[size - 1], mem_stack[size - 2]);
+	}
+
+	//n cells, every step cells from the first one, pushed in this order
+	template < typename T >
+	inline void MemoryHeap<T>::Push(const T* cells, int step, unsigned int n)
+	{
+		if (mem_stack.size() + n > stack_limit + 1) { //overflows on the same cell as single pushes
+			for (; n > 0; --n, cells += step)
+				Push(*cells);
+			return;
+		}
+
+		if (mem_stack.capacity() < mem_stack.size() + n)
+			mem_stack.reserve(std::max<size_t>(mem_stack.size() + n, 2 * mem_stack.capacity()));
+
+		for (; n > 0; --n, cells += step)
+			mem_stack.push_back(*cells);
+	}
+
+	//n cells, every step cells from the first one, get the values from the top in this order
+	template < typename T >
+	inline void MemoryHeap<T>::Pop(T* cells, int step, unsigned int n)
+	{
+		const unsigned int taken = static_cast<unsigned int>(std::min<size_t>(n, mem_stack.size()));
+
+		for (unsigned int i = 0; i < taken; ++i, cells += step)
+			*cells = mem_stack[mem_stack.size() - 1 - i];
+		mem_stack.resize(mem_stack.size() - taken);
+
+		for (n -= taken; n > 0; --n, cells += step)
+			*cells = 0;
+	}
+
+	//&>&>& - cells from the pointer to pointer + last are pushed and the pointer ends on the last one,
+	//a run which leaves the tape is done cell by cell, so it wraps, grows or fails like the moves
+	template < typename T >
+	template < typename Tape >
+	inline void MemoryHeap<T>::PushRun(Tape& memory, int last)
+	{
+		const int step = last < 0 ? -1 : 1;
+
+		if (memory.InRange(std::min(last, 0), std::abs(last) + 1)) {
+			Push(memory.GetValue(), step, std::abs(last) + 1);
+			memory.Shift(last);
+			return;
+		}
+
+		for (int i = 0; ; i += step) {
+			Push(*memory.GetValue());
+			if (i == last)
+				break;
+			step > 0 ? memory.MoveRight() : memory.MoveLeft();
+		}
+	}
+
+	//^>^>^
+	template < typename T >
+	template < typename Tape >
+	inline void MemoryHeap<T>::PopRun(Tape& memory, int last)
+	{
+		const int step = last < 0 ? -1 : 1;
+
+		if (memory.InRange(std::min(last, 0), std::abs(last) + 1)) {
+			Pop(memory.GetValue(), step, std::abs(last) + 1);
+			memory.Shift(last);
+			return;
+		}
+
+		for (int i = 0; ; i += step) {
+			*memory.GetValue() = Pop();
+			if (i == last)
+				break;
+			step > 0 ? memory.MoveRight() : memory.MoveLeft();
+		}
+	}
 }
\ No newline at end of file
@@ -2,179 +2,287 @@
 #include <cstring> //memcpy, memset
 #include <iostream>
 #include <climits>
+#include <cstddef>
 
 #include "MemoryTape.h"
 #include "DebugLogStream.h"
 #include "BrainThreadRuntimeException.h"
 
+#if defined(__AVX2__)
+ #include <immintrin.h>
+ #define BT_SCAN_AVX2
+#elif defined(__SSE2__)
+ #include <emmintrin.h>
+ #define BT_SCAN_SSE2
+#endif
+
+#ifdef BT_GUARD_PAGES
+ #include <mutex>
+ #include <signal.h>
+ #include <unistd.h>
+ #include <sys/mman.h>
+#endif
+
 namespace BT {
 
+	/*
+	 * Kernels of the scan loops [>] and [<] with stride 1.
+	 * 8-bit cells use memchr/memrchr, wider cells compare a whole vector with zero at once.
+	*/
 	template < typename T >
-	MemoryTape<T>::MemoryTape(unsigned int mem_size, eof_option eof_behavior, mem_option mem_behavior)
-		: eof_behavior(eof_behavior), mem_behavior(mem_behavior)
+	static T* FindZeroForward(T* from, T* last)
 	{
-		try {
-			mem = new T[mem_size];
+		if constexpr (sizeof(T) == 1) {
+			return static_cast<T*>(std::memchr(from, 0, last - from + 1));
 		}
-		catch (const std::bad_alloc&) {
-			throw BFAllocException(mem_size, sizeof(T));
-		}
-		catch (...) {
-			throw BFUnkownException();
+		else {
+#if defined(BT_SCAN_AVX2)
+			constexpr int n = 32 / sizeof(T);
+			const __m256i zero = _mm256_setzero_si256();
+			for (; last - from >= n - 1; from += n) {
+				const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(from));
+				const unsigned int mask = _mm256_movemask_epi8(sizeof(T) == 2 ? _mm256_cmpeq_epi16(v, zero) : _mm256_cmpeq_epi32(v, zero));
+				if (mask)
+					return from + __builtin_ctz(mask) / sizeof(T);
+			}
+#elif defined(BT_SCAN_SSE2)
+			constexpr int n = 16 / sizeof(T);
+			const __m128i zero = _mm_setzero_si128();
+			for (; last - from >= n - 1; from += n) {
+				const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(from));
+				const unsigned int mask = _mm_movemask_epi8(sizeof(T) == 2 ? _mm_cmpeq_epi16(v, zero) : _mm_cmpeq_epi32(v, zero));
+				if (mask)
+					return from + __builtin_ctz(mask) / sizeof(T);
+			}
+#endif
+			for (; from <= last; ++from) {
+				if (*from == 0)
+					return from;
+			}
+			return nullptr;
 		}
-
-		len = mem_size;
-		pointer = mem;
-		max_mem = (T*)&mem[len - 1];
-
-		std::memset(mem, 0, sizeof(T) * len);   //inicjujemy zerami
 	}
 
 	template < typename T >
-	MemoryTape<T>::MemoryTape(const MemoryTape<T>& memory)
-		: eof_behavior(memory.eof_behavior), mem_behavior(memory.mem_behavior)
+	static T* FindZeroBackward(T* from, T* first)
 	{
-		try {
-			mem = new T[memory.len];
+#ifdef __GLIBC__
+		if constexpr (sizeof(T) == 1) {
+			return static_cast<T*>(memrchr(first, 0, from - first + 1));
 		}
-		catch (const std::bad_alloc&) {
-			throw BFAllocException(memory.len, sizeof(T));
+#endif
+		std::ptrdiff_t i = from - first;
+#if defined(BT_SCAN_AVX2)
+		constexpr int n = 32 / sizeof(T);
+		const __m256i zero = _mm256_setzero_si256();
+		for (; i >= n - 1; i -= n) {
+			const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first + i - (n - 1)));
+			const __m256i eq = sizeof(T) == 1 ? _mm256_cmpeq_epi8(v, zero) : sizeof(T) == 2 ? _mm256_cmpeq_epi16(v, zero) : _mm256_cmpeq_epi32(v, zero);
+			const unsigned int mask = _mm256_movemask_epi8(eq);
+			if (mask)
+				return first + i - (n - 1) + (31 - __builtin_clz(mask)) / sizeof(T);
 		}
-		catch (...) {
-			throw BFUnkownException();
+#elif defined(BT_SCAN_SSE2)
+		constexpr int n = 16 / sizeof(T);
+		const __m128i zero = _mm_setzero_si128();
+		for (; i >= n - 1; i -= n) {
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first + i - (n - 1)));
+			const __m128i eq = sizeof(T) == 1 ? _mm_cmpeq_epi8(v, zero) : sizeof(T) == 2 ? _mm_cmpeq_epi16(v, zero) : _mm_cmpeq_epi32(v, zero);
+			const unsigned int mask = _mm_movemask_epi8(eq);
+			if (mask)
+				return first + i - (n - 1) + (31 - __builtin_clz(mask)) / sizeof(T);
 		}
-
-		len = memory.len;
-		pointer = mem + memory.PointerPosition();
-		max_mem = (T*)&mem[len - 1];
-
-		memcpy(mem, memory.mem, sizeof(T) * len);
+#endif
+		for (; i >= 0; --i) {
+			if (first[i] == 0)
+				return first + i;
+		}
+		return nullptr;
 	}
 
-	template < typename T >
-	MemoryTape<T>::~MemoryTape(void)
+#ifdef BT_GUARD_PAGES
+	/*
+	 * Faults in the guards of a limited tape. An engine running code without range checks
+	 * arms its sigsetjmp point, the handler jumps back there with 1 for the left guard
+	 * and 2 for the right one. The first write to a page shared with a fork copies the page
+	 * and the write is done again. Any other fault ends the program like before.
+	*/
+	static thread_local const char* guard_begin = nullptr;
+	static thread_local const char* guard_tape = nullptr;
+	static thread_local const char* guard_end = nullptr;
+	static thread_local sigjmp_buf* guard_target = nullptr;
+
+	static void TapeFaultHandler(int, siginfo_t* info, void*)
 	{
-		delete[] mem;
-		pointer = nullptr;
-		max_mem = nullptr;
-		len = 0;
+		const char* const address = static_cast<const char*>(info->si_addr);
+		if (guard_target && address >= guard_begin && address < guard_end)
+			siglongjmp(*guard_target, address < guard_tape ? 1 : 2);
+
+		if (info->si_code == SEGV_ACCERR && TapePages::Unshare(address))
+			return;
+
+		signal(SIGSEGV, SIG_DFL); //not ours, the instruction faults again
 	}
 
-	/*Funkcje  - komendy*/
-	template < typename T >
-	void MemoryTape<T>::Increment(void)
+	static void InstallFaultHandler()
 	{
-		++(*pointer);
+		static std::once_flag installed;
+		std::call_once(installed, []() {
+			struct sigaction action = {};
+			action.sa_sigaction = &TapeFaultHandler;
+			action.sa_flags = SA_SIGINFO;
+			sigemptyset(&action.sa_mask);
+			sigaction(SIGSEGV, &action, nullptr);
+		});
 	}
-	template < typename T >
-	void MemoryTape<T>::Increment(int amount)
+
+	template < typename T, mem_option M, eof_option E >
+	void MemoryTape<T, M, E>::ArmGuard(sigjmp_buf* target) const
 	{
-		(*pointer) += amount;
+		InstallFaultHandler();
+
+		guard_begin = static_cast<const char*>(pages->Mapping());
+		guard_tape = reinterpret_cast<const char*>(mem);
+		guard_end = guard_begin + pages->MappingSize();
+		guard_target = target;
 	}
-	template < typename T >
-	void MemoryTape<T>::Decrement(void)
+
+	template < typename T, mem_option M, eof_option E >
+	void MemoryTape<T, M, E>::DisarmGuard()
 	{
-		--(*pointer);
+		guard_target = nullptr;
 	}
-	template < typename T >
-	void MemoryTape<T>::Decrement(int amount)
+#endif
+
+	template < typename T, mem_option M, eof_option E >
+	MemoryTape<T, M, E>::MemoryTape(unsigned int mem_size)
 	{
-		(*pointer) -= amount;
+		Allocate(mem_size);
+		pointer = mem;
 	}
 
-	template < typename T >
-	void MemoryTape<T>::MoveRight(void)
+	//on Linux the copy maps the same pages, a page is copied when the first of the tapes writes it
+	template < typename T, mem_option M, eof_option E >
+	MemoryTape<T, M, E>::MemoryTape(const MemoryTape<T, M, E>& memory)
 	{
-		if (pointer >= max_mem)
-		{
-			switch (mem_behavior)
-			{
-			case mem_option::moContinuousTape:
-				pointer = mem; //na poczatek
-				return;
-			case mem_option::moDynamic:
-			{
-				try	{
-					Realloc();
-				}
-				catch (const BrainThreadRuntimeException& e) {
-					throw e;
-				}
-			}
-			break;
-			case mem_option::moLimited:
-			default:
-				throw BFRangeException(PointerPosition() + 1);
-			}
+#ifdef BT_GUARD_PAGES
+		InstallFaultHandler();
+
+		try {
+			pages = memory.pages->Share();
+		}
+		catch (const std::bad_alloc&) {
+			throw BFAllocException(memory.len, sizeof(T));
 		}
-		++pointer;
+
+		mem = reinterpret_cast<T*>(pages->Data() + (reinterpret_cast<char*>(memory.mem) - memory.pages->Data()));
+		len = memory.len;
+		max_mem = (T*)&mem[len - 1];
+		pointer = mem + memory.PointerPosition();
+#else
+		Allocate(memory.len);
+		pointer = mem + memory.PointerPosition();
+
+		memcpy(mem, memory.mem, sizeof(T) * len);
+#endif
 	}
 
-	template < typename T >
-	void MemoryTape<T>::MoveRight(int amount)
+	//takes the cells over, the moved tape is left empty
+	template < typename T, mem_option M, eof_option E >
+	MemoryTape<T, M, E>::MemoryTape(MemoryTape<T, M, E>&& memory)
+		: pointer(memory.pointer), mem(memory.mem), len(memory.len), max_mem(memory.max_mem)
 	{
-		do {
-			MoveRight();
-		} while (--amount);
+#ifdef BT_GUARD_PAGES
+		pages = std::move(memory.pages);
+#endif
+		memory.pointer = nullptr;
+		memory.mem = nullptr;
+		memory.max_mem = nullptr;
+		memory.len = 0;
 	}
 
-	template < typename T >
-	void MemoryTape<T>::MoveLeft(void)
+	template < typename T, mem_option M, eof_option E >
+	MemoryTape<T, M, E>::~MemoryTape(void)
 	{
-		if (pointer <= mem)
-		{
-			switch (mem_behavior)
-			{
-			case mem_option::moContinuousTape:
-				pointer = max_mem; //na koniec
-				return;
-			case mem_option::moDynamic:
-			case mem_option::moLimited:
-			default:
-				throw BFRangeException(-1);
-			}
-		}
-		--pointer;
+#ifdef BT_GUARD_PAGES
+		pages.reset();
+#else
+		delete[] mem;
+#endif
+		pointer = nullptr;
+		max_mem = nullptr;
+		len = 0;
 	}
 
-	template < typename T >
-	void MemoryTape<T>::MoveLeft(int amount)
+	//zeroed tape; on Linux it is made of pages which forks share, a limited tape is mapped
+	//between two guards and ends right at the second one
+	template < typename T, mem_option M, eof_option E >
+	void MemoryTape<T, M, E>::Allocate(unsigned int mem_size)
 	{
-		do {
-			MoveLeft();
-		} while (--amount);
+#ifdef BT_GUARD_PAGES
+		const size_t bytes = sizeof(T) * static_cast<size_t>(mem_size);
+
+		try {
+			pages.reset(new TapePages(bytes, M == mem_option::moLimited ? guard_size : 0));
+		}
+		catch (const std::bad_alloc&) {
+			throw BFAllocException(mem_size, sizeof(T));
+		}
+
+		mem = reinterpret_cast<T*>(M == mem_option::moLimited ? pages->Data() + pages->Size() - bytes : pages->Data());
+		len = mem_size;
+		max_mem = (T*)&mem[len - 1];
+#else
+		try {
+			mem = new T[mem_size];
+		}
+		catch (const std::bad_alloc&) {
+			throw BFAllocException(mem_size, sizeof(T));
+		}
+		catch (...) {
+			throw BFUnkownException();
+		}
+
+		len = mem_size;
+		max_mem = (T*)&mem[len - 1];
+
+		std::memset(mem, 0, sizeof(T) * len);   //inicjujemy zerami
+#endif
 	}
 
-	template < typename T >
-	void MemoryTape<T>::Read(void)
+	template < typename T, mem_option M, eof_option E >
+	void MemoryTape<T, M, E>::Read(int offset)
 	{
+		T* const cell = offset ? Reach(offset) : pointer;
+
 		if (std::cin.peek() == std::char_traits<char>::eof())
 		{
-			switch (eof_behavior) {
-				case eof_option::eoZero: *pointer = 0; return;
-				case eof_option::eoMinusOne: *pointer = -1; return; 
-			}
+			if constexpr (E == eof_option::eoZero)
+				*cell = 0;
+			else if constexpr (E == eof_option::eoMinusOne)
+				*cell = -1;
+			return;
 		}
-		*pointer = std::cin.get();
+		*cell = std::cin.get();
 	}
 	/*
 	funkcja ma dwie specjalizacje - ascii sa od 0 do 127
 	Reszt� trzeba konwertowac na char
 	*/
-	template <>
-	void MemoryTape<char>::Write(void)
-	{
-		std::cout << *pointer << std::flush;
-	}
-	template < typename T >
-	void MemoryTape<T>::Write(void)
+	template < typename T, mem_option M, eof_option E >
+	void MemoryTape<T, M, E>::Write(int offset)
 	{
-		std::cout << static_cast<char>(*pointer) << std::flush;
+		if constexpr (std::is_same<T, char>::value)
+			std::cout << *(offset ? Reach(offset) : pointer) << std::flush;
+		else
+			std::cout << static_cast<char>(*(offset ? Reach(offset) : pointer)) << std::flush;
 	}
 
-	template < typename T >
-	void MemoryTape<T>::DecimalRead(void)
+	template < typename T, mem_option M, eof_option E >
+	void MemoryTape<T, M, E>::DecimalRead(int offset)
 	{
+		T* const cell = offset ? Reach(offset) : pointer;
+
 		unsigned int i; //niewa�ne, czy signed czy unsigned
 		std::cin >> i;
 
@@ -184,33 +292,111 @@ namespace BT {
 			std::cin.ignore(UINT_MAX, '\n');
 			throw BFInvalidInputStreamException();
 		}
-		*pointer = static_cast<T>(i);
+		*cell = static_cast<T>(i);
 	}
 
-	template< typename T>
-	void MemoryTape<T>::DecimalWrite(void)
+	template < typename T, mem_option M, eof_option E >
+	void MemoryTape<T, M, E>::DecimalWrite(int offset)
 	{
+		const T value = *(offset ? Reach(offset) : pointer);
+
 		if constexpr (std::is_signed<T>::value)
-			std::cout << static_cast<int>(*pointer) << std::flush;
+			std::cout << static_cast<int>(value) << std::flush;
 		else
-			std::cout << static_cast<unsigned int>(*pointer) << std::flush;
+			std::cout << static_cast<unsigned int>(value) << std::flush;
+	}
+
+	//komrka o offset dostaje warto * factor; skrt ptli [->+<], dla 0 ptla si nie wykonuje
+	template < typename T, mem_option M, eof_option E >
+	void MemoryTape<T, M, E>::MulAdd(int offset, int factor)
+	{
+		if (*pointer == 0)
+			return;
+
+		const T value = *pointer;
+		T* const target = Reach(offset); //the loop walks to the target
+
+		*target = static_cast<T>(static_cast<unsigned int>(*target) + static_cast<unsigned int>(value) * static_cast<unsigned int>(factor));
+	}
+
+	//[>] with a stride, at the end of the tape it behaves like MoveRight
+	template < typename T, mem_option M, eof_option E >
+	void MemoryTape<T, M, E>::ScanRight(unsigned int stride)
+	{
+		while (*pointer)
+		{
+			if (stride == 1) {
+				T* const zero = FindZeroForward(pointer, max_mem);
+				if (zero) {
+					pointer = zero;
+					return;
+				}
+				pointer = max_mem;
+			}
+			else {
+				while (static_cast<unsigned int>(max_mem - pointer) >= stride) {
+					pointer += stride;
+					if (*pointer == 0)
+						return;
+				}
+			}
+			MoveRight(stride); //wrap, realloc or error
+		}
+	}
+
+	template < typename T, mem_option M, eof_option E >
+	void MemoryTape<T, M, E>::ScanLeft(unsigned int stride)
+	{
+		while (*pointer)
+		{
+			if (stride == 1) {
+				T* const zero = FindZeroBackward(pointer, mem);
+				if (zero) {
+					pointer = zero;
+					return;
+				}
+				pointer = mem;
+			}
+			else {
+				while (static_cast<unsigned int>(pointer - mem) >= stride) {
+					pointer -= stride;
+					if (*pointer == 0)
+						return;
+				}
+			}
+			MoveLeft(stride);
+		}
 	}
 
 	/*Funkcje wewntrzne tasmy*/
 
-	template < typename T >//funkcja zwraca nowa ilo�� pami�ci dla procesu
-	unsigned int MemoryTape<T>::GetNewMemorySize()
+	template < typename T, mem_option M, eof_option E >//funkcja zwraca nowa ilo�� pami�ci dla procesu
+	unsigned int MemoryTape<T, M, E>::GetNewMemorySize()
 	{
 		return (len <= double_mem_grow_limit) ? 2 * len : len + mem_grow_size;
 	}
 
-	template < typename T > //realokuje pami�� (zmienia rozmiar pami�ci i kopiuje star� zawarto��)
-	void MemoryTape<T>::Realloc()
+	template < typename T, mem_option M, eof_option E > //realokuje pami�� (zmienia rozmiar pami�ci i kopiuje star� zawarto��)
+	void MemoryTape<T, M, E>::Realloc()
 	{
 		T* new_mem;
 		unsigned int new_mem_size = GetNewMemorySize();
 		unsigned int p_pos = PointerPosition();
 
+#ifdef BT_GUARD_PAGES
+		std::unique_ptr<TapePages> new_pages;
+		try {
+			new_pages.reset(new TapePages(sizeof(T) * static_cast<size_t>(new_mem_size), 0));
+		}
+		catch (const std::bad_alloc&) {
+			throw BFAllocException(new_mem_size, sizeof(T));
+		}
+
+		//the new chunk is zeroed already
+		new_mem = reinterpret_cast<T*>(new_pages->Data());
+		std::memcpy(new_mem, mem, sizeof(T) * len);
+		pages = std::move(new_pages);
+#else
 		try {
 			new_mem = new T[new_mem_size];
 		}
@@ -223,9 +409,10 @@ namespace BT {
 
 		//copy and zero the new chunk
 		std::memset(new_mem + len, 0, sizeof(T) * (new_mem_size - len));
-		std::memcpy(new_mem, mem, len);
+		std::memcpy(new_mem, mem, sizeof(T) * len);
 
 		delete[] mem;
+#endif
 
 		mem = new_mem;
 		pointer = mem + p_pos;
@@ -233,20 +420,8 @@ namespace BT {
 		max_mem = (T*)&mem[len - 1];
 	}
 
-	template < typename T >
-	inline unsigned int MemoryTape<T>::PointerPosition() const
-	{
-		return pointer - mem;
-	}
-
-	template < typename T >
-	inline T* const MemoryTape<T>::GetValue() const
-	{
-		return pointer;
-	}
-
-	template < typename T > //pokazuje n kom�rek w lewo i w prawo ze wska�nikiem mozliwie po�rodku
-	void MemoryTape<T>::SimpleMemoryDump(std::ostream& s, unsigned near_cells)
+	template < typename T, mem_option M, eof_option E > //pokazuje n kom�rek w lewo i w prawo ze wska�nikiem mozliwie po�rodku
+	void MemoryTape<T, M, E>::SimpleMemoryDump(std::ostream& s, unsigned near_cells)
 	{
 		unsigned int start = ((int)PointerPosition() - (int)near_cells) <= 0 ? 0 : (PointerPosition() - near_cells);
 		const unsigned int end = near_cells * 2 + start;
@@ -261,8 +436,8 @@ namespace BT {
 		s << std::endl;
 	}
 
-	template < typename T >
-	void MemoryTape<T>::MemoryDump(std::ostream& o)
+	template < typename T, mem_option M, eof_option E >
+	void MemoryTape<T, M, E>::MemoryDump(std::ostream& o)
 	{
 		o << "\nBRAINTHREAD MEMORY DUMP (shows only nonzero cells)\n"
 		  << "Pointer at: " << PointerPosition() << "\n"
@@ -306,10 +481,10 @@ namespace BT {
 	}
 
 	// Explicit template instantiation
-	template class MemoryTape<char>;
-	template class MemoryTape<unsigned char>;
-	template class MemoryTape<unsigned short>;
-	template class MemoryTape<unsigned int>;
-	template class MemoryTape<short>;
-	template class MemoryTape<int>;
+	BT_INSTANTIATE_BEHAVIORS(MemoryTape, char)
+	BT_INSTANTIATE_BEHAVIORS(MemoryTape, unsigned char)
+	BT_INSTANTIATE_BEHAVIORS(MemoryTape, unsigned short)
+	BT_INSTANTIATE_BEHAVIORS(MemoryTape, unsigned int)
+	BT_INSTANTIATE_BEHAVIORS(MemoryTape, short)
+	BT_INSTANTIATE_BEHAVIORS(MemoryTape, int)
 }
\ No newline at end of file
@@ -2,33 +2,65 @@
 
 #include <stack>
 #include <ostream>
+#include <memory>
 
 #include "Enumdefs.h"
+#include "BrainThreadRuntimeException.h"
+
+#if defined(__linux__)
+	#define BT_GUARD_PAGES
+	#include <csetjmp>
+	#include "TapePages.h"
+#endif
 
 namespace BT {
 
-	template < typename T >
+	template < typename T, mem_option M, eof_option E >
+	class BrainThreadProcess;
+	template < typename T, mem_option M, eof_option E >
+	class JitInterpreter;
+
+	/*
+	 * Klasa MemoryTape
+	 * The memory and EOF behaviors are template parameters, so every mode gets its own
+	 * code with the checks of the other modes folded away. Moves and cell access are
+	 * defined below the class to be inlined into the engines.
+	*/
+	template < typename T, mem_option M, eof_option E >
 	class MemoryTape
 	{
+		//threaded engine and the JIT keep the pointer in a local and call back here only on the slow path
+		friend class BrainThreadProcess<T, M, E>;
+		friend class JitInterpreter<T, M, E>;
+
 	public:		
-		MemoryTape(unsigned int mem_size, eof_option eof_behavior, mem_option option);
-		MemoryTape(const MemoryTape<T>& memory);
+		MemoryTape(unsigned int mem_size);
+		MemoryTape(const MemoryTape<T, M, E>& memory);
+		MemoryTape(MemoryTape<T, M, E>&& memory);
 		~MemoryTape(void);
 
 		void Increment(void);
-		void Increment(int);
+		void Increment(int amount, int offset = 0);
 		void Decrement(void);
-		void Decrement(int);
+		void Decrement(int amount, int offset = 0);
 
 		void MoveLeft(void);
 		void MoveLeft(int);
 		void MoveRight(void);
 		void MoveRight(int);
 
-		void Read(void);
-		void Write(void);
-		void DecimalRead(void);
-		void DecimalWrite(void);
+		void MulAdd(int offset, int factor);
+		void ScanRight(unsigned int stride);
+		void ScanLeft(unsigned int stride);
+
+		T* Reach(int offset);
+		bool InRange(int offset, unsigned int cells) const;
+		void Shift(int amount);
+
+		void Read(int offset = 0);
+		void Write(int offset = 0);
+		void DecimalRead(int offset = 0);
+		void DecimalWrite(int offset = 0);
 
 		unsigned int PointerPosition() const;
 		T* const GetValue() const;
@@ -36,16 +68,29 @@ namespace BT {
 		void SimpleMemoryDump(std::ostream& s, unsigned near_cells = 5);
 		void MemoryDump(std::ostream& o);
 
+#ifdef BT_GUARD_PAGES
+		//limited tape ends at an inaccessible region, reaching into it raises SIGSEGV
+		static const unsigned int guard_size = 1048576; //1 Mb, more than the longest move (USHRT_MAX cells of 4 bytes)
+
+		bool IsGuarded() const { return M == mem_option::moLimited; }
+		void ArmGuard(sigjmp_buf* target) const;
+		static void DisarmGuard();
+#endif
+
 	protected:
 		T* pointer; //pirko
 
 		T* mem; //pamiec
 		unsigned len; //aktualny rozmiar pamieci
 
+#ifdef BT_GUARD_PAGES
+		std::unique_ptr<TapePages> pages; //cells of the tape, shared with the forks until written
+#endif
+
 		T* max_mem; //ostatnia komrka pamici
 
-		const mem_option mem_behavior; //zachowanie pamieci
-		const eof_option eof_behavior; //reakcja na EOF z wejcia
+		static constexpr mem_option mem_behavior = M; //zachowanie pamieci
+		static constexpr eof_option eof_behavior = E; //reakcja na EOF z wejcia
 
 		static const unsigned int double_mem_grow_limit = 2147483648; //2 Mb 
 		//ten limit oznacza, ze do tej liczby objto pamici si dubluje,
@@ -55,5 +100,132 @@ namespace BT {
 
 		unsigned int GetNewMemorySize();
 		void Realloc();
+		void Allocate(unsigned int mem_size);
 	};
-}
\ No newline at end of file
+
+	/*Funkcje  - komendy*/
+	template < typename T, mem_option M, eof_option E >
+	inline void MemoryTape<T, M, E>::Increment(void)
+	{
+		++(*pointer);
+	}
+	template < typename T, mem_option M, eof_option E >
+	inline void MemoryTape<T, M, E>::Increment(int amount, int offset)
+	{
+		*(offset ? Reach(offset) : pointer) += amount;
+	}
+	template < typename T, mem_option M, eof_option E >
+	inline void MemoryTape<T, M, E>::Decrement(void)
+	{
+		--(*pointer);
+	}
+	template < typename T, mem_option M, eof_option E >
+	inline void MemoryTape<T, M, E>::Decrement(int amount, int offset)
+	{
+		*(offset ? Reach(offset) : pointer) -= amount;
+	}
+
+	template < typename T, mem_option M, eof_option E >
+	inline void MemoryTape<T, M, E>::MoveRight(void)
+	{
+		if (pointer >= max_mem)
+		{
+			if constexpr (M == mem_option::moContinuousTape) {
+				pointer = mem; //na poczatek
+				return;
+			}
+			else if constexpr (M == mem_option::moDynamic)
+				Realloc();
+			else
+				throw BFRangeException(PointerPosition() + 1);
+		}
+		++pointer;
+	}
+
+	template < typename T, mem_option M, eof_option E >
+	inline void MemoryTape<T, M, E>::MoveRight(int amount)
+	{
+		if (max_mem - pointer >= amount) { //one check for the whole move
+			pointer += amount;
+			return;
+		}
+
+		do {
+			MoveRight();
+		} while (--amount);
+	}
+
+	template < typename T, mem_option M, eof_option E >
+	inline void MemoryTape<T, M, E>::MoveLeft(void)
+	{
+		if (pointer <= mem)
+		{
+			if constexpr (M == mem_option::moContinuousTape) {
+				pointer = max_mem; //na koniec
+				return;
+			}
+			else
+				throw BFRangeException(-1);
+		}
+		--pointer;
+	}
+
+	template < typename T, mem_option M, eof_option E >
+	inline void MemoryTape<T, M, E>::MoveLeft(int amount)
+	{
+		if (pointer - mem >= amount) {
+			pointer -= amount;
+			return;
+		}
+
+		do {
+			MoveLeft();
+		} while (--amount);
+	}
+
+	//cell at pointer + offset reached like with moves (wrap, realloc or error), the pointer stays
+	template < typename T, mem_option M, eof_option E >
+	inline T* MemoryTape<T, M, E>::Reach(int offset)
+	{
+		if (InRange(offset, 1))
+			return pointer + offset;
+
+		const unsigned int origin = PointerPosition();
+
+		if (offset > 0)
+			MoveRight(offset);
+		else if (offset < 0)
+			MoveLeft(-offset);
+
+		T* const cell = pointer;
+		pointer = mem + origin; //tape might have been reallocated
+		return cell;
+	}
+
+	//cells pointer + offset ... pointer + offset + cells - 1 are all on the tape
+	template < typename T, mem_option M, eof_option E >
+	inline bool MemoryTape<T, M, E>::InRange(int offset, unsigned int cells) const
+	{
+		const long long first = static_cast<long long>(PointerPosition()) + offset;
+		return first >= 0 && first + cells <= static_cast<long long>(max_mem - mem) + 1;
+	}
+
+	//move without any checks, only for ranges confirmed by InRange
+	template < typename T, mem_option M, eof_option E >
+	inline void MemoryTape<T, M, E>::Shift(int amount)
+	{
+		pointer += amount;
+	}
+
+	template < typename T, mem_option M, eof_option E >
+	inline unsigned int MemoryTape<T, M, E>::PointerPosition() const
+	{
+		return pointer - mem;
+	}
+
+	template < typename T, mem_option M, eof_option E >
+	inline T* const MemoryTape<T, M, E>::GetValue() const
+	{
+		return pointer;
+	}
+}
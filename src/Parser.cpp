@@ -1,5 +1,6 @@
 #include "Parser.h"
 #include "MessageLog.h"
+#include "CodeGraph.h"
 
 #include <cstring>
 #include <stack>
@@ -7,6 +8,8 @@
 #include <algorithm>
 #include <iterator>
 #include <charconv>
+#include <vector>
+#include <cstdlib>
 
 namespace BT {
 
@@ -43,7 +46,8 @@ namespace BT {
 			return false;
 		}
 
-		instructions.reserve(source.size());
+		//comments are not stored
+		instructions.reserve(std::count_if(source.begin(), source.end(), [this](const char& c) { return isValidOperator(c); }) + 1);
 
 		for (std::string::const_iterator it = source.begin(); it < source.end(); ++it)
 		{
@@ -65,20 +69,30 @@ namespace BT {
 						}
 						else {
 							loop_call_stack.push(GetValidPos(it, source.begin(), ignore_ins));
-							instructions.emplace_back(curr_op);
+							instructions.emplace_back(curr_op, UINT_MAX, 0);
 
 							//optimizer_entrypoint.push_back(instructions.size() - 1);
 						}
 					}				
 					else {
 						loop_call_stack.push(GetValidPos(it, source.begin(), ignore_ins));
-						instructions.emplace_back(curr_op);
+						instructions.emplace_back(curr_op, UINT_MAX, 0);
 					}					
 				}
 				else if (curr_op == bt_operation::btoEndLoop /*|| curr_op == btoInvEndLoop*/)
 				{
 					if (loop_call_stack.empty() == false)
 					{
+						if constexpr (OLevel > 1) {
+							//optimize [->+<] to cell[1] += cell, :=0 and [>] to a scan
+							const unsigned int loop_end = GetValidPos(it, source.begin(), ignore_ins);
+							if (OptimizeScanLoop(loop_call_stack.top()) || OptimizeMulLoop(loop_call_stack.top())) {
+								ignore_ins += loop_end + 1 - static_cast<unsigned int>(instructions.size());
+								loop_call_stack.pop();
+								continue;
+							}
+						}
+
 						instructions[loop_call_stack.top()].jump = GetValidPos(it, source.begin(), ignore_ins);
 						instructions.emplace_back(curr_op, loop_call_stack.top());
 
@@ -219,6 +233,16 @@ namespace BT {
 
 		instructions.emplace_back(bt_operation::btoEndProgram);
 
+		if constexpr (OLevel > 1) {
+			if (syntaxOk) {
+				EliminateDeadCode();
+				FoldHeapRuns();
+				DeferMoves();
+				FindLoopRanges();
+			}
+		}
+		instructions.shrink_to_fit();
+
 		return syntaxOk;
 	}
 
@@ -377,6 +401,348 @@ namespace BT {
 		}
 	}
 
+	/*
+	 * Replaces a balanced loop, which only adds and moves and changes its own cell
+	 * by one per turn, with a MulAdd for every touched cell and :=0.
+	 * The loop runs cell times (or -cell times), so every target gets delta * cell.
+	*/
+	template <CodeLang Lang, int OLevel>
+	bool Parser<Lang, OLevel>::OptimizeMulLoop(unsigned int loop_begin)
+	{
+		std::vector<std::pair<int, int>> deltas; //offset, sum of changes; in order of the first visit
+		int offset = 0, min_offset = 0, max_offset = 0;
+
+		auto add = [&](int amount) {
+			auto t = std::find_if(deltas.begin(), deltas.end(), [offset](const std::pair<int, int>& d) { return d.first == offset; });
+			if (t == deltas.end())
+				deltas.emplace_back(offset, amount);
+			else
+				t->second += amount;
+		};
+
+		for (auto it = instructions.begin() + loop_begin + 1; it < instructions.end(); ++it)
+		{
+			switch (it->operation)
+			{
+				case bt_operation::btoIncrement:
+				case bt_operation::btoOPT_Increment: add(it->repetitions); break;
+				case bt_operation::btoDecrement:
+				case bt_operation::btoOPT_Decrement: add(-it->repetitions); break;
+				case bt_operation::btoMoveRight:
+				case bt_operation::btoOPT_MoveRight: offset += it->repetitions; max_offset = std::max(max_offset, offset); break;
+				case bt_operation::btoMoveLeft:
+				case bt_operation::btoOPT_MoveLeft: offset -= it->repetitions; min_offset = std::min(min_offset, offset); break;
+				default: return false;
+			}
+		}
+
+		auto origin = std::find_if(deltas.begin(), deltas.end(), [](const std::pair<int, int>& d) { return d.first == 0; });
+		if (offset != 0 || origin == deltas.end() || (origin->second != 1 && origin->second != -1))
+			return false;
+
+		//the loop would stop at the tape boundary, so the farthest cells have to be checked by a MulAdd
+		auto touched = [&deltas](int o) {
+			return o == 0 || std::any_of(deltas.begin(), deltas.end(), [o](const std::pair<int, int>& d) { return d.first == o; });
+		};
+		if (!touched(min_offset) || !touched(max_offset))
+			return false;
+
+		const int direction = -origin->second;
+		for (const auto& d : deltas) {
+			if (d.first != 0 && std::abs(d.second) > USHRT_MAX)
+				return false;
+		}
+
+		instructions.erase(instructions.begin() + loop_begin, instructions.end());
+		for (const auto& d : deltas)
+		{
+			if (d.first == 0)
+				continue;
+
+			const int factor = d.second * direction;
+			instructions.emplace_back(factor < 0 ? bt_operation::btoOPT_MulSub : bt_operation::btoOPT_MulAdd, UINT_MAX, static_cast<unsigned short>(std::abs(factor)));
+			instructions.back().offset = d.first;
+		}
+		instructions.emplace_back(bt_operation::btoOPT_SetCellToZero);
+
+		return true;
+	}
+
+	//[>], [<<] etc. - a loop with a single move looks for a zero cell
+	template <CodeLang Lang, int OLevel>
+	bool Parser<Lang, OLevel>::OptimizeScanLoop(unsigned int loop_begin)
+	{
+		if (instructions.size() != loop_begin + 2)
+			return false;
+
+		const bt_instruction move = instructions.back();
+		switch (move.operation)
+		{
+			case bt_operation::btoMoveRight:
+			case bt_operation::btoOPT_MoveRight:
+				instructions.erase(instructions.begin() + loop_begin, instructions.end());
+				instructions.emplace_back(bt_operation::btoOPT_ScanRight, UINT_MAX, move.repetitions);
+				return true;
+			case bt_operation::btoMoveLeft:
+			case bt_operation::btoOPT_MoveLeft:
+				instructions.erase(instructions.begin() + loop_begin, instructions.end());
+				instructions.emplace_back(bt_operation::btoOPT_ScanLeft, UINT_MAX, move.repetitions);
+				return true;
+			default:
+				return false;
+		}
+	}
+
+	//>>+<-< to +@2 -@1 <: moves inside a block become offsets of the cell instructions,
+	//the pointer is moved once at the end of the block
+	template <CodeLang Lang, int OLevel>
+	void Parser<Lang, OLevel>::DeferMoves()
+	{
+		CodeTape result;
+		result.reserve(instructions.size());
+
+		int offset = 0, lowest = 0, highest = 0; //walk of the pointer since the last flush
+		bool lowest_reached = true, highest_reached = true; //the extreme cell is checked by an instruction
+
+		auto move = [&result](int delta) {
+			while (delta != 0) {
+				const int step = std::min(std::abs(delta), static_cast<int>(USHRT_MAX));
+				result.emplace_back(delta > 0 ? bt_operation::btoOPT_MoveRight : bt_operation::btoOPT_MoveLeft, UINT_MAX, static_cast<unsigned short>(step));
+				delta -= (delta > 0 ? step : -step);
+			}
+		};
+
+		//extremes no instruction has touched are still visited, so range errors stay where they were
+		auto flush = [&]() {
+			int at = 0;
+			if (!lowest_reached && lowest != offset) {
+				move(lowest - at);
+				at = lowest;
+			}
+			if (!highest_reached && highest != offset) {
+				move(highest - at);
+				at = highest;
+			}
+			move(offset - at);
+			offset = lowest = highest = 0;
+			lowest_reached = highest_reached = true;
+		};
+
+		for (const bt_instruction& ins : instructions)
+		{
+			switch (ins.operation)
+			{
+			case bt_operation::btoMoveRight:
+			case bt_operation::btoOPT_MoveRight:
+				offset += ins.repetitions;
+				if (offset > highest) {
+					highest = offset;
+					highest_reached = false;
+				}
+				continue;
+			case bt_operation::btoMoveLeft:
+			case bt_operation::btoOPT_MoveLeft:
+				offset -= ins.repetitions;
+				if (offset < lowest) {
+					lowest = offset;
+					lowest_reached = false;
+				}
+				continue;
+			default:
+				break;
+			}
+
+			if (CodeAnalyser::IsOffsetInstruction(ins))
+			{
+				const bool io = (ins.operation != bt_operation::btoOPT_Increment &&
+					ins.operation != bt_operation::btoOPT_Decrement &&
+					ins.operation != bt_operation::btoOPT_SetCellToZero);
+
+				//no output before a pending range error
+				if (io && (!lowest_reached || !highest_reached))
+					flush();
+
+				if (offset == lowest)
+					lowest_reached = true;
+				if (offset == highest)
+					highest_reached = true;
+
+				result.push_back(ins);
+				result.back().offset = offset;
+			}
+			else
+			{
+				flush();
+				result.push_back(ins);
+			}
+		}
+
+		//jumps point to the new positions
+		std::stack<unsigned int> loops, functions;
+		for (unsigned int i = 0; i < result.size(); ++i)
+		{
+			switch (result[i].operation)
+			{
+			case bt_operation::btoBeginLoop: loops.push(i); break;
+			case bt_operation::btoBeginFunction: functions.push(i); break;
+			case bt_operation::btoEndLoop:
+				result[i].jump = loops.top();
+				result[loops.top()].jump = i;
+				loops.pop();
+				break;
+			case bt_operation::btoEndFunction:
+				result[i].jump = functions.top();
+				result[functions.top()].jump = i;
+				functions.pop();
+				break;
+			default:
+				break;
+			}
+		}
+
+		instructions = std::move(result);
+	}
+
+	//a loop which starts on a zero cell is never entered: at the start of the program, after
+	//another loop, [-] or a scan; bodies of functions are never run if nothing calls them
+	template <CodeLang Lang, int OLevel>
+	void Parser<Lang, OLevel>::EliminateDeadCode()
+	{
+		const bool calls = std::any_of(instructions.begin(), instructions.end(),
+			[](const bt_instruction& ins) { return ins.operation == bt_operation::btoCallFunction; });
+		unsigned int removed = 0;
+
+		auto remove_dead_loops = [&removed](std::vector<code_node>& body, bool zero) {
+			std::vector<code_node> live;
+			live.reserve(body.size());
+
+			for (code_node& node : body)
+			{
+				if (node.kind == node_kind::nkLoop && zero) {
+					removed += CodeGraph::Size(node);
+					continue;
+				}
+
+				if (node.kind == node_kind::nkBlock) {
+					const bt_operation last = node.instructions.back().operation;
+					zero = (last == bt_operation::btoOPT_SetCellToZero || last == bt_operation::btoOPT_ScanRight || last == bt_operation::btoOPT_ScanLeft);
+				}
+				else if (node.kind != node_kind::nkFunction) //a definition does not change the cell
+					zero = (node.kind == node_kind::nkLoop);
+
+				live.push_back(std::move(node));
+			}
+			body = std::move(live);
+		};
+
+		CodeGraph graph(instructions);
+		remove_dead_loops(graph.Nodes(), true);
+
+		graph.ForEach([&](code_node& node) {
+			if (node.kind == node_kind::nkFunction && !calls) {
+				unsigned int size = 0;
+				for (const code_node& inner : node.body)
+					size += CodeGraph::Size(inner);
+
+				//the definition stays, a second one with the same identifier is still an error
+				if (size > 1) {
+					removed += size - 1;
+					node.body.clear();
+					node.body.emplace_back(node_kind::nkBlock);
+					node.body.back().instructions.emplace_back(bt_operation::btoOPT_NoOperation);
+				}
+			}
+			else if (node.kind == node_kind::nkLoop) {
+				remove_dead_loops(node.body, false);
+			}
+		});
+
+		if (removed > 0) {
+			instructions = graph.Lower();
+			MessageLog::Instance().AddInfo("Optimizer: removed " + std::to_string(removed) + " instructions of dead code (" +
+				std::to_string(removed * sizeof(bt_instruction)) + " bytes)");
+		}
+	}
+
+	//&>&>& and ^<^<^ to one instruction, the heap takes all the cells at once
+	template <CodeLang Lang, int OLevel>
+	void Parser<Lang, OLevel>::FoldHeapRuns()
+	{
+		if (std::none_of(instructions.begin(), instructions.end(),
+			[](const bt_instruction& ins) { return ins.operation == bt_operation::btoPush || ins.operation == bt_operation::btoPop; }))
+			return;
+
+		//direction of a move by one cell, 0 for the other instructions
+		auto step_of = [](const bt_instruction& ins) {
+			if (ins.repetitions != 1)
+				return 0;
+			switch (ins.operation)
+			{
+			case bt_operation::btoMoveRight:
+			case bt_operation::btoOPT_MoveRight: return 1;
+			case bt_operation::btoMoveLeft:
+			case bt_operation::btoOPT_MoveLeft: return -1;
+			default: return 0;
+			}
+		};
+
+		bool folded = false;
+		CodeGraph graph(instructions);
+
+		graph.ForEach([&](code_node& node) {
+			if (node.kind != node_kind::nkBlock)
+				return;
+
+			const std::vector<bt_instruction>& block = node.instructions;
+			std::vector<bt_instruction> result;
+			result.reserve(block.size());
+
+			for (size_t i = 0; i < block.size(); ++i)
+			{
+				const bt_operation op = block[i].operation;
+				if (op == bt_operation::btoPush || op == bt_operation::btoPop)
+				{
+					const int step = i + 1 < block.size() ? step_of(block[i + 1]) : 0;
+					int last = 0;
+					while (step != 0 && i + 2 < block.size() && step_of(block[i + 1]) == step && block[i + 2].operation == op && std::abs(last) < SHRT_MAX) {
+						last += step;
+						i += 2;
+					}
+
+					if (last != 0) {
+						result.emplace_back(op == bt_operation::btoPush ? bt_operation::btoOPT_PushRun : bt_operation::btoOPT_PopRun, UINT_MAX, static_cast<unsigned short>(std::abs(last) + 1));
+						result.back().offset = last;
+						folded = true;
+						continue;
+					}
+				}
+				result.push_back(block[i]);
+			}
+			node.instructions = std::move(result);
+		});
+
+		if (folded)
+			instructions = graph.Lower();
+	}
+
+	//a loop which ends every iteration on the cell it started on touches the same cells each time,
+	//so it keeps them: repetitions of [ is the count (0 - unknown), repetitions of ] the distance
+	//from the first one to the loop cell
+	template <CodeLang Lang, int OLevel>
+	void Parser<Lang, OLevel>::FindLoopRanges()
+	{
+		CodeGraph graph(instructions);
+
+		graph.ForEach([](code_node& node) {
+			if (node.kind == node_kind::nkLoop && node.fixed && node.highest - node.lowest < USHRT_MAX) {
+				node.instructions.front().repetitions = static_cast<unsigned short>(node.highest - node.lowest + 1);
+				node.instructions.back().repetitions = static_cast<unsigned short>(-node.lowest);
+			}
+		});
+
+		instructions = graph.Lower();
+	}
+
 	template <CodeLang Lang, int OLevel>
 	void Parser<Lang, OLevel>::HandlePragma(const std::string::const_iterator& begin, const std::string::const_iterator& end, const unsigned int err_pos) {
 		//#115+ -> 115x +
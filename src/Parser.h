@@ -13,6 +13,7 @@ namespace BT {
 	*/
 	class ParserBase {
 		friend class CodeAnalyser;
+		template < typename T > friend class PrefixEvaluator;
 	protected:
 		CodeTape instructions;
 		bool syntaxValid;
@@ -39,6 +40,13 @@ namespace BT {
 		bt_operation MapCharToOperator(const char& c) const;
 		bt_operation MapOperatorToOptimizedOp(const bt_operation& op) const;
 
+		bool OptimizeMulLoop(unsigned int loop_begin);
+		bool OptimizeScanLoop(unsigned int loop_begin);
+		void EliminateDeadCode();
+		void FoldHeapRuns();
+		void DeferMoves();
+		void FindLoopRanges();
+
 		void HandlePragma(const std::string::const_iterator& begin, const std::string::const_iterator& end, const unsigned int err_pos);
 
 		unsigned int GetValidPos(const std::string::const_iterator& pos, const std::string::const_iterator& begin, unsigned int ignore_ins) const;
@@ -0,0 +1,218 @@
+#include "PrefixEvaluator.h"
+
+#include <algorithm>
+#include <limits>
+#include <climits>
+
+namespace BT {
+
+	template < typename T >
+	PrefixEvaluator<T>::PrefixEvaluator(unsigned int mem_size) : mem_size(mem_size), cells(1, 0), pointer(0)
+	{
+	}
+
+	//false if nothing could be evaluated, the code is left as it was
+	template < typename T >
+	bool PrefixEvaluator<T>::Evaluate(ParserBase& parser)
+	{
+		CodeTape& code = parser.instructions;
+		unsigned int ip = 0, depth = 0, resume = 0;
+		unsigned int steps = 0;
+
+		//state before the top level loop, restored if it does not finish
+		std::vector<cell_type> saved_cells;
+		unsigned int saved_pointer = 0;
+		size_t saved_output = 0;
+
+		while (true)
+		{
+			if (depth == 0) {
+				resume = ip;
+				if (code[ip].operation == bt_operation::btoBeginLoop) {
+					saved_cells = cells;
+					saved_pointer = pointer;
+					saved_output = output.size();
+				}
+			}
+			if (steps++ == step_limit || !Step(code, ip, depth))
+				break;
+		}
+
+		if (depth > 0) {
+			cells = std::move(saved_cells);
+			pointer = saved_pointer;
+			output.resize(saved_output);
+		}
+
+		if (resume == 0)
+			return false;
+
+		CodeTape result = Image();
+		const unsigned int delta = static_cast<unsigned int>(result.size()) - resume;
+
+		for (unsigned int i = resume; i < code.size(); ++i) {
+			result.push_back(code[i]);
+			if (result.back().IsLinked())
+				result.back().jump += delta;
+		}
+
+		result.shrink_to_fit();
+		code = std::move(result);
+		return true;
+	}
+
+	//false if the instruction can not be evaluated, then the state is not changed
+	template < typename T >
+	bool PrefixEvaluator<T>::Step(const CodeTape& code, unsigned int& ip, unsigned int& depth)
+	{
+		const bt_instruction& ins = code[ip];
+		const long long target = static_cast<long long>(pointer) + ins.offset;
+
+		switch (ins.operation)
+		{
+		case bt_operation::btoIncrement:
+		case bt_operation::btoOPT_Increment:
+			if (!Reach(target))
+				return false;
+			cells[target] += static_cast<cell_type>(ins.repetitions);
+			break;
+		case bt_operation::btoDecrement:
+		case bt_operation::btoOPT_Decrement:
+			if (!Reach(target))
+				return false;
+			cells[target] -= static_cast<cell_type>(ins.repetitions);
+			break;
+		case bt_operation::btoOPT_SetCellToZero:
+			if (!Reach(target))
+				return false;
+			cells[target] = 0;
+			break;
+		case bt_operation::btoMoveRight:
+		case bt_operation::btoOPT_MoveRight:
+			if (!Reach(static_cast<long long>(pointer) + ins.repetitions))
+				return false;
+			pointer += ins.repetitions;
+			break;
+		case bt_operation::btoMoveLeft:
+		case bt_operation::btoOPT_MoveLeft:
+			if (!Reach(static_cast<long long>(pointer) - ins.repetitions))
+				return false;
+			pointer -= ins.repetitions;
+			break;
+		case bt_operation::btoOPT_MulAdd:
+		case bt_operation::btoOPT_MulSub:
+			if (cells[pointer] != 0) {
+				if (!Reach(target))
+					return false;
+				const unsigned int factor = ins.operation == bt_operation::btoOPT_MulAdd ? ins.repetitions : 0u - ins.repetitions;
+				cells[target] = static_cast<cell_type>(static_cast<unsigned int>(cells[target]) + static_cast<unsigned int>(cells[pointer]) * factor);
+			}
+			break;
+		case bt_operation::btoOPT_ScanRight:
+		case bt_operation::btoOPT_ScanLeft:
+		{
+			long long p = pointer;
+			const long long stride = ins.operation == bt_operation::btoOPT_ScanRight ? ins.repetitions : -static_cast<long long>(ins.repetitions);
+			while (cells[p] != 0) {
+				if (!Reach(p + stride))
+					return false;
+				p += stride;
+			}
+			pointer = static_cast<unsigned int>(p);
+			break;
+		}
+		case bt_operation::btoAsciiWrite:
+		case bt_operation::btoDecimalWrite:
+			if (!Reach(target))
+				return false;
+			for (unsigned short i = 0; i < ins.repetitions; ++i)
+				output.emplace_back(ins.operation, cells[target]);
+			break;
+		case bt_operation::btoBeginLoop:
+			if (cells[pointer] == 0) {
+				ip = ins.jump + 1;
+				return true;
+			}
+			++depth;
+			break;
+		case bt_operation::btoEndLoop:
+			if (cells[pointer] != 0) {
+				ip = ins.jump + 1;
+				return true;
+			}
+			--depth;
+			break;
+		case bt_operation::btoOPT_NoOperation:
+			break;
+		default:
+			return false; //input, threads, functions, heaps, debug and the end
+		}
+
+		++ip;
+		return true;
+	}
+
+	//the cell at position has to be on the tape, the evaluator does not loop or grow it
+	template < typename T >
+	bool PrefixEvaluator<T>::Reach(long long position)
+	{
+		if (position < 0 || position >= mem_size)
+			return false;
+
+		if (position >= static_cast<long long>(cells.size()))
+			cells.resize(static_cast<size_t>(position) + 1, 0);
+		return true;
+	}
+
+	template < typename T >
+	void PrefixEvaluator<T>::Set(CodeTape& tape, cell_type value, int offset)
+	{
+		const bool up = value <= std::numeric_limits<cell_type>::max() / 2;
+		unsigned long long amount = up ? value : static_cast<cell_type>(0 - value);
+
+		while (amount > 0) {
+			const unsigned short n = static_cast<unsigned short>(std::min<unsigned long long>(amount, USHRT_MAX));
+			tape.emplace_back(up ? bt_operation::btoOPT_Increment : bt_operation::btoOPT_Decrement, UINT_MAX, n);
+			tape.back().offset = offset;
+			amount -= n;
+		}
+	}
+
+	//output written through the first cell, then the cells and the pointer
+	template < typename T >
+	CodeTape PrefixEvaluator<T>::Image() const
+	{
+		CodeTape image;
+		cell_type scratch = 0;
+
+		for (const auto& out : output) {
+			if (out.second != scratch) {
+				if (scratch != 0)
+					image.emplace_back(bt_operation::btoOPT_SetCellToZero);
+				Set(image, out.second, 0);
+				scratch = out.second;
+			}
+			image.emplace_back(out.first);
+		}
+		if (scratch != 0)
+			image.emplace_back(bt_operation::btoOPT_SetCellToZero);
+
+		for (unsigned int i = 0; i < cells.size(); ++i)
+			Set(image, cells[i], static_cast<int>(i));
+
+		for (unsigned int n = pointer; n > 0; ) {
+			const unsigned short move = static_cast<unsigned short>(std::min<unsigned int>(n, USHRT_MAX));
+			image.emplace_back(bt_operation::btoOPT_MoveRight, UINT_MAX, move);
+			n -= move;
+		}
+		return image;
+	}
+
+	// Explicit template instantiation
+	template class PrefixEvaluator<char>;
+	template class PrefixEvaluator<unsigned char>;
+	template class PrefixEvaluator<unsigned short>;
+	template class PrefixEvaluator<unsigned int>;
+	template class PrefixEvaluator<short>;
+	template class PrefixEvaluator<int>;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+#include <type_traits>
+
+#include "CodeTape.h"
+#include "Parser.h"
+
+namespace BT {
+
+	/*
+	 * Klasa PrefixEvaluator
+	 * Runs the start of the program which does not need the input during the compilation.
+	 * The executed part of the tape is replaced by code which prints the same output and
+	 * sets the cells and the pointer as they were left, the rest is kept as it was.
+	 * Stops before input, threads, functions, the heaps and debug instructions, on a range
+	 * error and after step_limit instructions. Only whole top level instructions are
+	 * replaced, a loop which did not finish is evaluated again at run time.
+	*/
+	template < typename T >
+	class PrefixEvaluator
+	{
+	public:
+		PrefixEvaluator(unsigned int mem_size);
+
+		bool Evaluate(ParserBase& parser);
+
+		static const unsigned int step_limit = 1 << 24;
+
+	protected:
+		typedef typename std::make_unsigned<T>::type cell_type;
+
+		const unsigned int mem_size;
+
+		std::vector<cell_type> cells; //touched cells, from the first one
+		unsigned int pointer;
+		std::vector<std::pair<bt_operation, cell_type>> output;
+
+		bool Step(const CodeTape& code, unsigned int& ip, unsigned int& depth);
+		bool Reach(long long position);
+
+		static void Set(CodeTape& tape, cell_type value, int offset);
+		CodeTape Image() const;
+	};
+}
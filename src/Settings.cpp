@@ -83,6 +83,68 @@ namespace BT {
 					throw BrainThreadInvalidOptionException("memorybehavior", op_arg);
 			}
 
+			// --engine [switch|threaded|jit]
+			// --jit
+			if (ops >> GetOpt::OptionPresent("engine"))
+			{
+				ops >> GetOpt::Option("engine", op_arg);
+				if (op_arg == "switch")
+					OP_engine = engine_option::enSwitch;
+				else if (op_arg == "threaded")
+					OP_engine = engine_option::enThreaded;
+				else if (op_arg == "jit")
+					OP_engine = engine_option::enJit;
+				else
+					throw BrainThreadInvalidOptionException("engine", op_arg);
+			}
+			else if (ops >> GetOpt::OptionPresent("jit"))
+			{
+				OP_engine = engine_option::enJit;
+			}
+
+			// --quantum [<1,2^32>|loop]
+			if (ops >> GetOpt::OptionPresent("quantum"))
+			{
+				ops >> GetOpt::Option("quantum", op_arg);
+				if (op_arg == "loop")
+					OP_yield_quantum = 0;
+				else
+				{
+					auto res = std::from_chars(op_arg.data(), op_arg.data() + op_arg.size(), op_arg_i);
+
+					if (res.ec != std::errc() || op_arg_i < 1 || op_arg_i > UINT_MAX)
+						throw BrainThreadInvalidOptionException("quantum", op_arg);
+					else
+						OP_yield_quantum = (unsigned int)op_arg_i;
+				}
+			}
+
+			// --threads [system|pool|fiber]
+			if (ops >> GetOpt::OptionPresent("threads"))
+			{
+				ops >> GetOpt::Option("threads", op_arg);
+				if (op_arg == "system")
+					OP_threads = thread_option::toSystem;
+				else if (op_arg == "pool")
+					OP_threads = thread_option::toPool;
+				else if (op_arg == "fiber")
+					OP_threads = thread_option::toFiber;
+				else
+					throw BrainThreadInvalidOptionException("threads", op_arg);
+			}
+
+			// --blocking-heap
+			OP_blocking_heap = (ops >> GetOpt::OptionPresent("blocking-heap"));
+
+			// --emit-c [filename|-]
+			if (ops >> GetOpt::OptionPresent("emit-c"))
+			{
+				ops >> GetOpt::Option("emit-c", op_arg);
+				if (op_arg.empty())
+					throw BrainThreadInvalidOptionException("emit-c", op_arg);
+				OP_emit_c_path = op_arg;
+			}
+
 			// -l --language [bt|b|bf|pb|brainthread|brainfuck|brainfork|pbrain|auto]
 			if (ops >> GetOpt::OptionPresent('l', "language"))
 			{
@@ -104,9 +166,12 @@ namespace BT {
 			OP_analyse = (ops >> GetOpt::OptionPresent('a', "analyze"));
 
 			OP_optimize = (ops >> GetOpt::OptionPresent('o', "optimize")); //todo o2 o3
+			OP_partial_eval = (ops >> GetOpt::OptionPresent("partial-eval"));
 			OP_repair = (ops >> GetOpt::OptionPresent('r', "repair")); //niekoniecznie chce, aby debug naprawia�
 			OP_execute = (ops >> GetOpt::OptionPresent('x', "execute"));  //niekoniecznie chce, aby po debugu uruchamia�
 
+			if (OP_partial_eval)
+				OP_optimize = true;
 			if (OP_optimize || OP_repair)
 				OP_analyse = true;
 			if (OP_analyse == false)
@@ -16,6 +16,7 @@ namespace BT {
 		bool OP_analyse = false;
 		bool OP_repair = false;
 		bool OP_optimize = false;
+		bool OP_partial_eval = false;
 		bool OP_execute = true;
 		bool OP_nopause = Settings::IsRanFromConsole();
 
@@ -24,6 +25,7 @@ namespace BT {
 
 		std::string OP_source_code = "";
 		std::string OP_source_file_path = "";
+		std::string OP_emit_c_path = "";
 		std::string PAR_exe_path = "";
 
 		CodeLang OP_language = CodeLang::clBrainThread;
@@ -31,8 +33,12 @@ namespace BT {
 		mem_option OP_mem_behavior = mem_option::moLimited;
 		eof_option OP_eof_behavior = eof_option::eoZero;
 		cellsize_option OP_cellsize = cellsize_option::cs8;
+		engine_option OP_engine = engine_option::enSwitch;
+		thread_option OP_threads = thread_option::toSystem;
+		bool OP_blocking_heap = false;
 
 		unsigned int OP_mem_size = def_mem_size;
+		unsigned int OP_yield_quantum = def_yield_quantum;
 		
 		bool InitFromArguments(GetOpt::GetOpt_pp& ops);
 		bool InitFromString(const std::string& args);
@@ -40,5 +46,6 @@ namespace BT {
 		
 		static bool IsRanFromConsole();
 		static const int def_mem_size = 30000;
+		static const int def_yield_quantum = 256;
 	};
 }
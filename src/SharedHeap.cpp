@@ -0,0 +1,332 @@
+#include "SharedHeap.h"
+#include "DebugLogStream.h"
+#include "BrainThreadRuntimeException.h"
+
+#include <algorithm>
+
+namespace BT {
+
+	template < typename T >
+	SharedHeap<T>::SharedHeap(bool blocking) : shared(std::make_shared<cells>(blocking))
+	{
+		own = Acquire();
+		Enter();
+	}
+
+	//the same cells, used by another thread
+	template < typename T >
+	SharedHeap<T>::SharedHeap(const SharedHeap<T>& heap) : shared(heap.shared)
+	{
+		own = Acquire();
+		Enter();
+	}
+
+	//the record goes with the cells, the moved heap is not used any more
+	template < typename T >
+	SharedHeap<T>::SharedHeap(SharedHeap<T>&& heap) : shared(std::move(heap.shared)), own(heap.own)
+	{
+		heap.own = nullptr;
+	}
+
+	//the popped nodes stay in the record, the next thread which takes it frees them
+	template < typename T >
+	SharedHeap<T>::~SharedHeap()
+	{
+		if (own == nullptr)
+			return;
+
+		own->hazard[0].store(nullptr);
+		own->hazard[1].store(nullptr);
+		own->active.store(false, std::memory_order_release);
+		Leave();
+	}
+
+	//only when no thread uses the heap any more
+	template < typename T >
+	SharedHeap<T>::cells::~cells()
+	{
+		for (node* n = top.load(); n != nullptr; ) {
+			node* next = n->next;
+			delete n;
+			n = next;
+		}
+		for (record* r = records.load(); r != nullptr; ) {
+			record* next = r->next;
+			for (node* n : r->retired)
+				delete n;
+			delete r;
+			r = next;
+		}
+	}
+
+	//a record left by a finished thread or a new one, records are never removed
+	template < typename T >
+	typename SharedHeap<T>::record* SharedHeap<T>::Acquire()
+	{
+		for (record* r = shared->records.load(); r != nullptr; r = r->next) {
+			bool active = false;
+			if (!r->active.load(std::memory_order_relaxed) && r->active.compare_exchange_strong(active, true, std::memory_order_acquire))
+				return r;
+		}
+
+		record* r = new record;
+		r->next = shared->records.load();
+		while (!shared->records.compare_exchange_weak(r->next, r));
+		++shared->record_count;
+		return r;
+	}
+
+	//the top node, it is not freed until the hazard is cleared
+	template < typename T >
+	typename SharedHeap<T>::node* SharedHeap<T>::ProtectTop()
+	{
+		node* n = shared->top.load();
+		while (true) {
+			own->hazard[0].store(n);
+			node* again = shared->top.load();
+			if (again == n)
+				return n;
+			n = again;
+		}
+	}
+
+	template < typename T >
+	void SharedHeap<T>::Push(const T& value)
+	{
+		if (shared->size.load(std::memory_order_relaxed) > stack_limit)
+			throw BFMemoryStackOverflowException();
+
+		node* n = new node{ value, shared->top.load(std::memory_order_relaxed) };
+		while (!shared->top.compare_exchange_weak(n->next, n, std::memory_order_seq_cst, std::memory_order_relaxed));
+		shared->size.fetch_add(1, std::memory_order_relaxed);
+
+		//a sleeper counts itself before it looks at the top, one of the two sees the other
+		if (shared->blocking && shared->sleepers.load() > 0) {
+			std::unique_lock<std::mutex> lock(shared->park_mutex);
+			Wake(lock);
+		}
+	}
+
+	//zero when the heap is empty
+	template < typename T >
+	T SharedHeap<T>::Pop()
+	{
+		T value;
+		return TryPop(value) ? value : 0;
+	}
+
+	template < typename T >
+	bool SharedHeap<T>::TryPop(T& value)
+	{
+		node* n;
+		while ((n = ProtectTop()) != nullptr) {
+			if (shared->top.compare_exchange_strong(n, n->next))
+				break;
+		}
+		own->hazard[0].store(nullptr);
+
+		if (n == nullptr)
+			return false;
+
+		value = n->value;
+		shared->size.fetch_sub(1, std::memory_order_relaxed);
+		Retire(n);
+		return true;
+	}
+
+	/*
+	 * Until the next push, after the heap was found empty. A fiber gives its carrier to the
+	 * others, help runs other work meanwhile and the thread sleeps only when it has none.
+	 * Throws when every user of the heap waits.
+	*/
+	template < typename T >
+	void SharedHeap<T>::Wait(const std::function<bool(void)>& help)
+	{
+		cells& c = *shared;
+		std::unique_lock<std::mutex> lock(c.park_mutex);
+		c.sleepers.fetch_add(1);
+
+		if (!c.deadlock && c.top.load() == nullptr) {
+			const unsigned int generation = c.generation;
+			++c.waiting;
+			CheckDeadlock(lock);
+			if (!lock.owns_lock())
+				lock.lock();
+
+			while (c.generation == generation) {
+				if (help) {
+					lock.unlock();
+					const bool helped = help();
+					lock.lock();
+					if (helped)
+						continue;
+				}
+#ifdef BT_FIBERS
+				if (FiberScheduler::fiber* f = FiberScheduler::Current()) {
+					c.parked.push_back(f);
+					lock.unlock();
+					FiberScheduler::Park();
+					lock.lock();
+					continue;
+				}
+#endif
+				c.pushed.wait(lock, [&c, generation]() { return c.generation != generation; });
+			}
+			--c.waiting;
+		}
+
+		c.sleepers.fetch_sub(1);
+		if (c.deadlock)
+			throw BFDeadlockException();
+	}
+
+	//the process waits for its children and pushes nothing meanwhile
+	template < typename T >
+	void SharedHeap<T>::Leave()
+	{
+		if (!shared->blocking)
+			return;
+
+		std::unique_lock<std::mutex> lock(shared->park_mutex);
+		--shared->users;
+		CheckDeadlock(lock);
+	}
+
+	template < typename T >
+	void SharedHeap<T>::Enter()
+	{
+		if (!shared->blocking)
+			return;
+
+		std::lock_guard<std::mutex> lock(shared->park_mutex);
+		++shared->users;
+	}
+
+	//every waiting thread tries again, the lock is released
+	template < typename T >
+	void SharedHeap<T>::Wake(std::unique_lock<std::mutex>& lock)
+	{
+		++shared->generation;
+#ifdef BT_FIBERS
+		std::vector<FiberScheduler::fiber*> fibers;
+		fibers.swap(shared->parked);
+#endif
+		lock.unlock();
+
+		shared->pushed.notify_all();
+#ifdef BT_FIBERS
+		for (FiberScheduler::fiber* f : fibers)
+			FiberScheduler::Instance().Wake(f);
+#endif
+	}
+
+	/*
+	 * Nobody left to push, everyone wakes up with an error. A woken thread which has not
+	 * popped yet still counts as waiting, but then the heap is not empty.
+	*/
+	template < typename T >
+	void SharedHeap<T>::CheckDeadlock(std::unique_lock<std::mutex>& lock)
+	{
+		if (shared->users == 0 || shared->waiting < shared->users || shared->top.load() != nullptr)
+			return;
+
+		shared->deadlock = true;
+		Wake(lock);
+	}
+
+	//nothing happens with less than two cells
+	template < typename T >
+	void SharedHeap<T>::Swap()
+	{
+		node* first = nullptr; //the new top, made once for all the attempts
+
+		while (true) {
+			node* a = ProtectTop();
+			node* b = a ? a->next : nullptr;
+			if (b == nullptr)
+				break;
+
+			//b can only be popped after a, so it is still on the heap while a is the top
+			own->hazard[1].store(b);
+			if (shared->top.load() != a)
+				continue;
+
+			if (first == nullptr)
+				first = new node{ T(), new node{ T(), nullptr } };
+			first->value = b->value;
+			first->next->value = a->value;
+			first->next->next = b->next;
+
+			if (shared->top.compare_exchange_strong(a, first)) {
+				own->hazard[0].store(nullptr);
+				own->hazard[1].store(nullptr);
+				Retire(a);
+				Retire(b);
+				return;
+			}
+		}
+
+		own->hazard[0].store(nullptr);
+		own->hazard[1].store(nullptr);
+		if (first != nullptr) {
+			delete first->next;
+			delete first;
+		}
+	}
+
+	template < typename T >
+	void SharedHeap<T>::Retire(node* n)
+	{
+		own->retired.push_back(n);
+		if (own->retired.size() >= std::max(scan_threshold, 4 * shared->record_count.load(std::memory_order_relaxed)))
+			Scan();
+	}
+
+	//frees the popped nodes no thread reads
+	template < typename T >
+	void SharedHeap<T>::Scan()
+	{
+		if (shared->walkers.load() > 0)
+			return;
+
+		std::vector<node*> hazards;
+		for (record* r = shared->records.load(); r != nullptr; r = r->next)
+			for (const std::atomic<node*>& hazard : r->hazard)
+				if (node* n = hazard.load())
+					hazards.push_back(n);
+		std::sort(hazards.begin(), hazards.end());
+
+		std::vector<node*> kept;
+		for (node* n : own->retired) {
+			if (std::binary_search(hazards.begin(), hazards.end(), n))
+				kept.push_back(n);
+			else
+				delete n;
+		}
+		own->retired.swap(kept);
+	}
+
+	template < typename T >
+	void SharedHeap<T>::PrintStack(std::ostream& s)
+	{
+		++shared->walkers;
+
+		s << "\n>Memory stack (fifo, " << shared->size.load() << ")\n";
+		for (node* n = shared->top.load(); n != nullptr; n = n->next)
+		{
+			PrintCellValue<T>(s, n->value);
+			s << (n->next == nullptr ? '\n' : ',');
+		}
+		s << std::flush;
+
+		--shared->walkers;
+	}
+
+	// Explicit template instantiation
+	template class SharedHeap<char>;
+	template class SharedHeap<unsigned char>;
+	template class SharedHeap<unsigned short>;
+	template class SharedHeap<unsigned int>;
+	template class SharedHeap<short>;
+	template class SharedHeap<int>;
+}
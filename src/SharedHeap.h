@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <ostream>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
+
+#include "FiberScheduler.h"
+
+namespace BT {
+
+	/*
+	 * Klasa SharedHeap
+	 * The heap of ~&, ~^ and ~%, shared by all the threads of the program. A lock-free
+	 * (Treiber) stack of nodes which do not change once pushed. Copies work on the same
+	 * cells and every copy is used by one thread: it keeps the nodes the thread reads
+	 * (hazard pointers) and the nodes it has popped until nobody reads them.
+	 * Swap replaces the two top nodes with new ones in one exchange of the top.
+	 * A blocking heap lets a thread wait for a push. It counts the processes which can
+	 * still push (users) and the waiting ones, when all of them wait it is a deadlock.
+	*/
+	template < typename T >
+	class SharedHeap
+	{
+	public:
+		SharedHeap(bool blocking = false);
+		SharedHeap(const SharedHeap<T>& heap);
+		SharedHeap(SharedHeap<T>&& heap);
+		~SharedHeap(void);
+
+		SharedHeap<T>& operator=(const SharedHeap<T>&) = delete;
+
+		void Push(const T&);
+		T Pop(void);
+		bool TryPop(T& value);
+		void Swap(void);
+
+		//blocking heap only
+		void Wait(const std::function<bool(void)>& help);
+		void Leave(void);
+		void Enter(void);
+
+		void PrintStack(std::ostream& s);
+
+	protected:
+		struct node
+		{
+			T value;
+			node* next;
+		};
+
+		//owned by one thread at a time
+		struct record
+		{
+			std::atomic<node*> hazard[2] = { nullptr, nullptr };
+			std::atomic<bool> active{ true };
+			std::vector<node*> retired; //popped, freed when no hazard points to them
+			record* next = nullptr;
+		};
+
+		struct cells
+		{
+			std::atomic<node*> top{ nullptr };
+			std::atomic<unsigned int> size{ 0 };
+			std::atomic<record*> records{ nullptr };
+			std::atomic<unsigned int> record_count{ 0 };
+			std::atomic<unsigned int> walkers{ 0 }; //PrintStack reads every node, nothing is freed meanwhile
+
+			const bool blocking;
+			std::atomic<unsigned int> sleepers{ 0 }; //a push with sleepers wakes them
+			std::mutex park_mutex;
+			std::condition_variable pushed;
+			unsigned int generation = 0; //wakes so far
+			unsigned int users = 0;
+			unsigned int waiting = 0; //users in Wait, also while they help
+			bool deadlock = false;
+#ifdef BT_FIBERS
+			std::vector<FiberScheduler::fiber*> parked; //fibers do not wait on the condition
+#endif
+
+			cells(bool blocking) : blocking(blocking) {}
+			~cells();
+		};
+
+		std::shared_ptr<cells> shared;
+		record* own;
+
+		static constexpr unsigned int stack_limit = 65536;
+		static constexpr unsigned int scan_threshold = 64;
+
+		record* Acquire(void);
+		node* ProtectTop(void);
+		void Retire(node* n);
+		void Scan(void);
+
+		void Wake(std::unique_lock<std::mutex>& lock);
+		void CheckDeadlock(std::unique_lock<std::mutex>& lock);
+	};
+}
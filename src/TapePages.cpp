@@ -0,0 +1,376 @@
+#include "TapePages.h"
+
+#if defined(__linux__)
+
+#include <new>
+#include <atomic>
+#include <mutex>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+namespace BT {
+
+	/*
+	 * The memory file. Its pages (slots) are given out once, in the order of the requests,
+	 * and counted by the tapes which map them; a slot no tape maps is given back to the system.
+	*/
+	namespace {
+		constexpr size_t slot_chunk = 65536; //counters are allocated in chunks of slots
+		constexpr size_t slot_chunks = 4096;
+		constexpr size_t no_slot = static_cast<size_t>(-1);
+
+		struct page_pool
+		{
+			int fd;
+			size_t page;
+			std::atomic<size_t> next{ 0 };
+			std::atomic<std::atomic<uint32_t>*> refs[slot_chunks];
+
+			page_pool() : page(static_cast<size_t>(sysconf(_SC_PAGESIZE)))
+			{
+				fd = memfd_create("brainthread-tape", MFD_CLOEXEC);
+				if (fd >= 0 && ftruncate(fd, static_cast<off_t>(slot_chunk * slot_chunks * page)) != 0) {
+					close(fd);
+					fd = -1;
+				}
+			}
+		};
+
+		page_pool& Pool()
+		{
+			static page_pool pool;
+			return pool;
+		}
+
+		std::atomic<uint32_t>& Refs(size_t slot)
+		{
+			return Pool().refs[slot / slot_chunk].load(std::memory_order_acquire)[slot % slot_chunk];
+		}
+
+		//n slots one after another, each mapped once
+		size_t AllocateSlots(size_t n)
+		{
+			page_pool& pool = Pool();
+			const size_t first = pool.next.fetch_add(n);
+			if (first + n > slot_chunk * slot_chunks)
+				return no_slot;
+
+			for (size_t c = first / slot_chunk; c <= (first + n - 1) / slot_chunk; ++c) {
+				if (pool.refs[c].load(std::memory_order_acquire) != nullptr)
+					continue;
+
+				void* const m = mmap(nullptr, slot_chunk * sizeof(std::atomic<uint32_t>), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+				if (m == MAP_FAILED)
+					return no_slot;
+
+				std::atomic<uint32_t>* expected = nullptr;
+				if (!pool.refs[c].compare_exchange_strong(expected, static_cast<std::atomic<uint32_t>*>(m)))
+					munmap(m, slot_chunk * sizeof(std::atomic<uint32_t>));
+			}
+
+			for (size_t s = first; s < first + n; ++s)
+				Refs(s).store(1, std::memory_order_relaxed);
+			return first;
+		}
+
+		void Punch(size_t first, size_t n)
+		{
+			if (n)
+				fallocate(Pool().fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, static_cast<off_t>(first * Pool().page), static_cast<off_t>(n * Pool().page));
+		}
+
+		//unmapped slots, neighbours are given back together
+		void ReleaseSlots(const std::vector<size_t>& slots)
+		{
+			size_t first = 0, n = 0;
+			for (size_t s : slots) {
+				if (Refs(s).fetch_sub(1, std::memory_order_acq_rel) != 1)
+					continue;
+				if (n && s == first + n) {
+					++n;
+					continue;
+				}
+				Punch(first, n);
+				first = s;
+				n = 1;
+			}
+			Punch(first, n);
+		}
+
+		bool WriteSlots(const char* from, size_t bytes, size_t slot)
+		{
+			off_t at = static_cast<off_t>(slot * Pool().page);
+			while (bytes) {
+				const ssize_t done = pwrite(Pool().fd, from, bytes, at);
+				if (done <= 0)
+					return false;
+				from += done;
+				at += done;
+				bytes -= static_cast<size_t>(done);
+			}
+			return true;
+		}
+	}
+
+	/*
+	 * Shared tapes for the SIGSEGV handler. Entries are reused and never freed, the handler
+	 * reads them again if any entry has changed meanwhile (odd version - a change is going on).
+	*/
+	struct tape_entry
+	{
+		std::atomic<const char*> begin{ nullptr };
+		std::atomic<const char*> end{ nullptr };
+		std::atomic<TapePages*> pages{ nullptr };
+		tape_entry* next = nullptr;
+	};
+
+	static std::mutex registry_mutex;
+	static std::atomic<tape_entry*> registry{ nullptr };
+	static std::atomic<unsigned int> registry_version{ 0 };
+	static std::atomic<unsigned int> registry_count{ 0 };
+
+	static TapePages* FindTape(const char* address)
+	{
+		while (true) {
+			const unsigned int version = registry_version.load(std::memory_order_acquire);
+			if (version & 1)
+				continue;
+
+			TapePages* found = nullptr;
+			for (tape_entry* e = registry.load(std::memory_order_acquire); e != nullptr; e = e->next) {
+				if (e->begin.load(std::memory_order_relaxed) <= address && address < e->end.load(std::memory_order_relaxed))
+					found = e->pages.load(std::memory_order_relaxed);
+			}
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (registry_version.load(std::memory_order_relaxed) == version)
+				return found;
+		}
+	}
+
+	void TapePages::Register()
+	{
+		std::lock_guard<std::mutex> lock(registry_mutex);
+
+		tape_entry* e = registry.load(std::memory_order_relaxed);
+		while (e != nullptr && e->pages.load(std::memory_order_relaxed) != nullptr)
+			e = e->next;
+		if (e == nullptr) {
+			e = new tape_entry;
+			e->next = registry.load(std::memory_order_relaxed);
+			registry.store(e, std::memory_order_release);
+		}
+
+		const unsigned int version = registry_version.load(std::memory_order_relaxed);
+		registry_version.store(version + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		e->begin.store(data, std::memory_order_relaxed);
+		e->end.store(data + size, std::memory_order_relaxed);
+		e->pages.store(this, std::memory_order_relaxed);
+		registry_version.store(version + 2, std::memory_order_release);
+
+		registered = e;
+		++registry_count;
+	}
+
+	void TapePages::Unregister()
+	{
+		std::lock_guard<std::mutex> lock(registry_mutex);
+
+		const unsigned int version = registry_version.load(std::memory_order_relaxed);
+		registry_version.store(version + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		registered->begin.store(nullptr, std::memory_order_relaxed);
+		registered->end.store(nullptr, std::memory_order_relaxed);
+		registered->pages.store(nullptr, std::memory_order_relaxed);
+		registry_version.store(version + 2, std::memory_order_release);
+
+		registered = nullptr;
+		--registry_count;
+	}
+
+	TapePages::TapePages() : mapping(nullptr), data(nullptr), size(0), guard(0), fragments(0), registered(nullptr)
+	{
+	}
+
+	//zeroed pages: slots of the memory file are never written before they are given out
+	TapePages::TapePages(size_t bytes, size_t guard) : mapping(nullptr), data(nullptr), guard(guard), fragments(0), registered(nullptr)
+	{
+		const size_t page = Pool().page;
+		size = std::max<size_t>(1, (bytes + page - 1) / page) * page;
+		Reserve();
+
+		if (Pool().fd < 0) {
+			if (mprotect(data, size, PROT_READ | PROT_WRITE) != 0) {
+				munmap(mapping, MappingSize());
+				throw std::bad_alloc();
+			}
+			return;
+		}
+
+		const size_t first = AllocateSlots(size / page);
+		if (first == no_slot) {
+			munmap(mapping, MappingSize());
+			throw std::bad_alloc();
+		}
+
+		for (size_t i = 0; i < size / page; ++i)
+			slots.push_back(first + i);
+		writable.assign(slots.size(), true);
+
+		if (!MapSlots(PROT_READ | PROT_WRITE)) {
+			ReleaseSlots(slots);
+			munmap(mapping, MappingSize());
+			throw std::bad_alloc();
+		}
+	}
+
+	TapePages::~TapePages()
+	{
+		if (registered)
+			Unregister();
+		if (mapping)
+			munmap(mapping, MappingSize());
+		ReleaseSlots(slots);
+	}
+
+	//the address space of the tape, nothing accessible yet
+	void TapePages::Reserve()
+	{
+		void* const m = mmap(nullptr, MappingSize(), PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (m == MAP_FAILED)
+			throw std::bad_alloc();
+
+		mapping = m;
+		data = static_cast<char*>(m) + guard;
+	}
+
+	//one mapping for every run of neighbouring slots
+	bool TapePages::MapSlots(int protection)
+	{
+		const size_t page = Pool().page;
+		fragments = 0;
+
+		for (size_t i = 0, n; i < slots.size(); i += n) {
+			n = 1;
+			while (i + n < slots.size() && slots[i + n] == slots[i] + n)
+				++n;
+
+			if (mmap(data + i * page, n * page, protection, MAP_SHARED | MAP_FIXED, Pool().fd, static_cast<off_t>(slots[i] * page)) == MAP_FAILED)
+				return false;
+			++fragments;
+		}
+		return true;
+	}
+
+	//the same cells for a new thread, the pages are copied when one of the tapes writes them
+	std::unique_ptr<TapePages> TapePages::Share()
+	{
+		std::unique_ptr<TapePages> copy(new TapePages());
+		copy->size = size;
+		copy->guard = guard;
+		copy->Reserve();
+
+		if (Pool().fd < 0) {
+			if (mprotect(copy->data, size, PROT_READ | PROT_WRITE) != 0)
+				throw std::bad_alloc();
+			std::memcpy(copy->data, data, size);
+			return copy;
+		}
+
+		if (fragments > FragmentLimit())
+			Consolidate();
+
+		for (size_t s : slots)
+			Refs(s).fetch_add(1, std::memory_order_relaxed);
+		copy->slots = slots;
+		copy->writable.assign(slots.size(), false);
+
+		if (!copy->MapSlots(PROT_READ))
+			throw std::bad_alloc();
+
+		if (!registered)
+			Register();
+		copy->Register();
+
+		mprotect(data, size, PROT_READ);
+		writable.assign(slots.size(), false);
+		fragments = copy->fragments;
+		return copy;
+	}
+
+	//the written page gets a slot of its own, unless no other tape maps its slot any more
+	bool TapePages::CopyPage(size_t i)
+	{
+		const size_t page = Pool().page;
+		char* const at = data + i * page;
+		const size_t slot = slots[i];
+
+		if (Refs(slot).load(std::memory_order_acquire) == 1) {
+			if (mprotect(at, page, PROT_READ | PROT_WRITE) != 0)
+				return false;
+		}
+		else {
+			const size_t copy = AllocateSlots(1);
+			if (copy == no_slot || !WriteSlots(at, page, copy))
+				return false;
+			if (mmap(at, page, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, Pool().fd, static_cast<off_t>(copy * page)) == MAP_FAILED)
+				return false;
+
+			slots[i] = copy;
+			if (Refs(slot).fetch_sub(1, std::memory_order_acq_rel) == 1)
+				Punch(slot, 1);
+		}
+
+		writable[i] = true;
+		++fragments;
+		return true;
+	}
+
+	//the whole tape copied to new slots and mapped at once again
+	void TapePages::Consolidate()
+	{
+		const size_t first = AllocateSlots(slots.size());
+		if (first == no_slot || !WriteSlots(data, size, first))
+			return;
+		if (mmap(data, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, Pool().fd, static_cast<off_t>(first * Pool().page)) == MAP_FAILED)
+			return;
+
+		ReleaseSlots(slots);
+		for (size_t i = 0; i < slots.size(); ++i)
+			slots[i] = first + i;
+		writable.assign(slots.size(), true);
+		fragments = 1;
+	}
+
+	size_t TapePages::FragmentLimit() const
+	{
+		return std::max<size_t>(16, map_budget / std::max(1u, registry_count.load(std::memory_order_relaxed)));
+	}
+
+	bool TapePages::Unshare(const void* address)
+	{
+		if (registry.load(std::memory_order_acquire) == nullptr)
+			return false;
+
+		const char* const at = static_cast<const char*>(address);
+		TapePages* const tape = FindTape(at);
+		if (tape == nullptr)
+			return false;
+
+		const size_t i = static_cast<size_t>(at - tape->data) / Pool().page;
+		if (tape->writable[i] || !tape->CopyPage(i))
+			return false;
+
+		if (tape->fragments > tape->FragmentLimit())
+			tape->Consolidate();
+		return true;
+	}
+}
+
+#endif
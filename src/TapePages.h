@@ -0,0 +1,66 @@
+#pragma once
+
+#if defined(__linux__)
+
+#include <cstddef>
+#include <vector>
+#include <memory>
+
+namespace BT {
+
+	struct tape_entry;
+
+	/*
+	 * Klasa TapePages
+	 * Memory of a tape on Linux: pages of one memory file shared by all the tapes, mapped
+	 * between two optional guards. Share() gives a tape with the same pages mapped read-only
+	 * to both tapes, the first write to such a page raises SIGSEGV and Unshare() gives
+	 * the writer its own copy of the page. A fork costs the mapping of the pages and
+	 * a copy of the pages written later, not a copy of the whole tape.
+	 * Without the memory file the pages are private and Share() copies them.
+	*/
+	class TapePages
+	{
+	public:
+		TapePages(size_t bytes, size_t guard);
+		~TapePages(void);
+
+		TapePages(const TapePages&) = delete;
+		TapePages& operator=(const TapePages&) = delete;
+
+		std::unique_ptr<TapePages> Share(void);
+
+		char* Data() const { return data; }
+		size_t Size() const { return size; }
+		void* Mapping() const { return mapping; }
+		size_t MappingSize() const { return size + 2 * guard; }
+
+		//for the SIGSEGV handler, true if the address was a shared page and can be written now
+		static bool Unshare(const void* address);
+
+	protected:
+		void* mapping; //pages with their guards
+		char* data;
+		size_t size;
+		size_t guard;
+
+		std::vector<size_t> slots; //page of the memory file for every page of the tape
+		std::vector<bool> writable; //false - shared or not written since the last fork
+		size_t fragments; //mappings the tape was split into, too many run out of the limit of the system
+		tape_entry* registered; //found by the SIGSEGV handler
+
+		static constexpr size_t map_budget = 32768; //mappings for all the tapes together
+
+		TapePages(void);
+
+		void Reserve(void);
+		bool MapSlots(int protection);
+		void Consolidate(void);
+		bool CopyPage(size_t page);
+		size_t FragmentLimit(void) const;
+		void Register(void);
+		void Unregister(void);
+	};
+}
+
+#endif
@@ -0,0 +1,132 @@
+#include "WorkPool.h"
+
+#include <algorithm>
+
+namespace BT {
+
+	static thread_local unsigned int own_worker = static_cast<unsigned int>(-1); //deque of the worker running on this thread
+	static thread_local unsigned int help_depth = 0;
+
+	//made on the first pooled fork
+	WorkPool& WorkPool::Instance()
+	{
+		static WorkPool pool(std::max(1u, std::thread::hardware_concurrency()));
+		return pool;
+	}
+
+	WorkPool::WorkPool(unsigned int n)
+	{
+		for (unsigned int i = 0; i <= n; ++i)
+			workers.push_back(std::make_unique<worker>());
+
+		for (unsigned int i = 0; i < n; ++i)
+			threads.emplace_back(&WorkPool::Work, this, i);
+	}
+
+	//every task has been joined by now, the workers only sleep
+	WorkPool::~WorkPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(sleep_mutex);
+			stopping = true;
+		}
+		sleep.notify_all();
+
+		for (std::thread& t : threads)
+			t.join();
+	}
+
+	unsigned int WorkPool::Self() const
+	{
+		return own_worker < threads.size() ? own_worker : static_cast<unsigned int>(threads.size());
+	}
+
+	void WorkPool::Submit(std::shared_ptr<task> t)
+	{
+		worker& w = *workers[Self()];
+
+		pending.fetch_add(1);
+		{
+			std::lock_guard<std::mutex> lock(w.mutex);
+			w.tasks.push_back(std::move(t));
+		}
+
+		//a worker between its check and its sleep does not miss the task
+		{
+			std::lock_guard<std::mutex> lock(sleep_mutex);
+		}
+		sleep.notify_one();
+	}
+
+	//the newest own task or the oldest task of another worker
+	std::shared_ptr<WorkPool::task> WorkPool::Take(unsigned int self)
+	{
+		for (unsigned int i = 0; i < workers.size(); ++i)
+		{
+			worker& w = *workers[(self + i) % workers.size()];
+			std::lock_guard<std::mutex> lock(w.mutex);
+			if (w.tasks.empty())
+				continue;
+
+			std::shared_ptr<task> t;
+			if (i == 0) {
+				t = std::move(w.tasks.back());
+				w.tasks.pop_back();
+			}
+			else {
+				t = std::move(w.tasks.front());
+				w.tasks.pop_front();
+			}
+			pending.fetch_sub(1);
+			return t;
+		}
+		return nullptr;
+	}
+
+	void WorkPool::Execute(task& t)
+	{
+		t.Run();
+		t.done.store(true, std::memory_order_release);
+	}
+
+	//help while waiting
+	void WorkPool::Wait(const task& t)
+	{
+		while (!t.done.load(std::memory_order_acquire))
+		{
+			if (!Help())
+				std::this_thread::yield();
+		}
+	}
+
+	//one task of the others, up to help_limit tasks deep
+	bool WorkPool::Help()
+	{
+		std::shared_ptr<task> other = help_depth < help_limit ? Take(Self()) : nullptr;
+		if (!other)
+			return false;
+
+		++help_depth;
+		Execute(*other);
+		--help_depth;
+		return true;
+	}
+
+	void WorkPool::Work(unsigned int self)
+	{
+		own_worker = self;
+
+		while (true)
+		{
+			if (std::shared_ptr<task> t = Take(self)) {
+				Execute(*t);
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(sleep_mutex);
+			sleep.wait(lock, [this]() { return pending.load() > 0 || stopping; });
+			if (stopping)
+				return;
+		}
+	}
+}
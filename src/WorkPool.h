@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+
+namespace BT {
+
+	/*
+	 * Klasa WorkPool
+	 * Fixed set of workers, one per core, which run the forked threads as tasks. Every worker
+	 * keeps the tasks it forks in its own deque and takes the newest one first, an idle
+	 * worker steals the oldest task of another one. A thread waiting for its children runs
+	 * the other tasks meanwhile. Threads outside the pool share one more deque.
+	*/
+	class WorkPool
+	{
+	public:
+		struct task
+		{
+			virtual ~task() = default;
+			virtual void Run(void) = 0;
+
+			std::atomic<bool> done{ false };
+		};
+
+		static WorkPool& Instance(void);
+
+		void Submit(std::shared_ptr<task> t);
+		void Wait(const task& t);
+		bool Help(void);
+
+		unsigned int Workers() const { return static_cast<unsigned int>(threads.size()); }
+
+	protected:
+		WorkPool(unsigned int workers);
+		~WorkPool(void);
+
+		struct worker
+		{
+			std::mutex mutex;
+			std::deque<std::shared_ptr<task>> tasks;
+		};
+
+		std::vector<std::unique_ptr<worker>> workers; //the last one is for the threads outside the pool
+		std::vector<std::thread> threads;
+
+		std::atomic<int> pending{ 0 }; //submitted, not taken yet
+		bool stopping = false;
+		std::mutex sleep_mutex;
+		std::condition_variable sleep;
+
+		static constexpr unsigned int help_limit = 64; //tasks run inside each other while waiting, the stack has to hold them
+
+		unsigned int Self(void) const;
+		std::shared_ptr<task> Take(unsigned int self);
+		void Execute(task& t);
+		void Work(unsigned int self);
+	};
+}
@@ -1,7 +1,13 @@
 #include <cassert>
+#include <sstream>
+#include <algorithm>
 
 #include "../src/Settings.h"
 #include "../src/BrainThread.h"
+#include "../src/CodeGenerator.h"
+#include "../src/CodeGraph.h"
+#include "../src/PrefixEvaluator.h"
+#include "../src/MemoryTape.h"
 
 using namespace BT;
 
@@ -9,6 +15,20 @@ ParserBase GetParser(std::string code){
     return Parser<CodeLang::clBrainThread, 1>(code);
 }
 
+std::string RunParsed(const ParserBase& parser, const Settings& settings){
+    std::ostringstream out;
+    std::streambuf* cout_buf = std::cout.rdbuf(out.rdbuf());
+
+    ProduceInterpreter(settings)->Run(parser.GetInstructions());
+
+    std::cout.rdbuf(cout_buf);
+    return out.str();
+}
+
+std::string RunCode(std::string code, const Settings& settings){
+    return RunParsed(ParseCode(code, settings), settings);
+}
+
 int main()
 {
     Settings settings;
@@ -22,5 +42,193 @@ int main()
 
 	ProduceInterpreter(settings)->Run(parser.GetInstructions());
 
+    //engines
+    const std::string hello = "++++++++[>++++[>++>+++>+++>+<<<<-]>+>+>->>+[<]<-]>>.>---.+++++++..+++.";
+    assert(RunCode(hello, settings) == "Hello");
+
+    Settings threaded;
+    threaded.OP_engine = engine_option::enThreaded;
+    assert(RunCode(hello, threaded) == "Hello");
+    assert(RunCode("+++(>++++++[<++++++++>-]<.)*[-]+++*", threaded) == "33");
+
+    Settings jit;
+    jit.OP_engine = engine_option::enJit;
+    jit.OP_cellsize = cellsize_option::cs16;
+    assert(RunCode(hello, jit) == "Hello");
+    assert(RunCode("+++(>++++++[<++++++++>-]<.)*[-]+++*", jit) == "33"); //falls back to the interpreter
+
+    Settings short_tape = jit;
+    short_tape.OP_mem_size = 4;
+    assert(RunCode(":>>>>>>:", short_tape) == "0"); //stops at the end of the tape
+    assert(RunCode(":>>>:<<<:", short_tape) == "000");
+
+    Settings looped_tape = threaded;
+    looped_tape.OP_mem_size = 4;
+    looped_tape.OP_mem_behavior = mem_option::moContinuousTape;
+    assert(RunCode("<+++:>>>>:", looped_tape) == "33");
+
+    //multiplication loops
+    Settings optimized;
+    optimized.OP_optimize = true;
+    ParserBase mul = ParseCode("++++++[>+++++++<-]>.", optimized);
+    assert(mul.GetInstructions()[1].operation == bt_operation::btoOPT_MulAdd);
+    assert(mul.GetInstructions()[1].offset == 1 && mul.GetInstructions()[1].repetitions == 7);
+    assert(RunCode("++++++[>+++++++<-]>.", optimized) == "*");
+
+    //scan loops
+    ParserBase scan = ParseCode("+>+>+>>+<<<<[>]>:", optimized);
+    assert(scan.GetInstructions()[4].operation == bt_operation::btoOPT_ScanRight);
+    assert(RunCode("+>+>+>>+<<<<[>]>:", optimized) == "1");
+
+    //offset-addressed cells, the pointer moves once per block
+    ParserBase offsets = ParseCode(">>+++<-<", optimized);
+    assert(offsets.GetInstructions()[0].operation == bt_operation::btoOPT_Increment);
+    assert(offsets.GetInstructions()[0].offset == 2 && offsets.GetInstructions()[0].repetitions == 3);
+    assert(offsets.GetInstructions()[1].operation == bt_operation::btoOPT_Decrement && offsets.GetInstructions()[1].offset == 1);
+    assert(offsets.GetInstructions()[2].operation == bt_operation::btoEndProgram);
+    assert(RunCode("+++>++++<:>:<", optimized) == "34");
+    assert(RunCode("+++>++++<:>:<", threaded) == "34");
+
+    //loop ranges, the cells of a balanced loop are checked once on entry
+    ParserBase ranges = ParseCode("+[<+>>[-]+[-<]>-]", optimized);
+    assert(ranges.GetInstructions()[1].operation == bt_operation::btoBeginLoop);
+    assert(ranges.GetInstructions()[1].repetitions == 0); //[-<] moves on every iteration
+    ParserBase balanced = ParseCode("++[>+[>+<-[-]]<-]>.", optimized);
+    assert(balanced.GetInstructions()[1].repetitions == 3 && balanced.GetInstructions()[balanced.GetInstructions()[1].jump].repetitions == 0);
+    assert(RunCode("+++++[>++++[>+++<-[-]]<-]>>:", optimized) == "15");
+
+    //packed instructions, non-jump instructions read the shared word as an offset
+    static_assert(sizeof(bt_instruction) == 8);
+    assert(bt_instruction(bt_operation::btoAsciiWrite).offset == 0);
+    assert(!bt_instruction(bt_operation::btoAsciiWrite).IsLinked());
+    ParserBase shrunk = ParseCode("+ comments are not stored >.", optimized);
+    assert(shrunk.GetInstructions().capacity() == shrunk.GetInstructions().size());
+
+    //code graph, lowering gives the same tape back
+    ParserBase graph_code = GetParser("+[>+<-](.){*>&[-]");
+    CodeGraph graph(graph_code.GetInstructions());
+    assert(graph.Nodes().size() == 8); //the last block is the end of the program
+    assert(graph.Nodes()[1].kind == node_kind::nkLoop && graph.Nodes()[1].fixed && graph.Nodes()[1].highest == 1);
+    assert(graph.Nodes()[2].kind == node_kind::nkFunction && graph.Nodes()[3].kind == node_kind::nkFork);
+    assert(graph.Nodes()[4].kind == node_kind::nkCall);
+    CodeTape lowered = graph.Lower();
+    assert(lowered.size() == graph_code.GetInstructions().size());
+    for (size_t i = 0; i < lowered.size(); ++i)
+        assert(lowered[i].operation == graph_code.GetInstructions()[i].operation && lowered[i].jump == graph_code.GetInstructions()[i].jump);
+
+    //dead code, loops entered on a zero cell and bodies of functions nobody calls
+    ParserBase dead = ParseCode("[comment.]+[-][.]>[<][>+<-.]+.", optimized);
+    assert(std::none_of(dead.GetInstructions().begin(), dead.GetInstructions().end(), [](const bt_instruction& ins) { return ins.operation == bt_operation::btoBeginLoop; }));
+    Settings pbrain = optimized;
+    pbrain.OP_language = CodeLang::clPBrain;
+    ParserBase uncalled = ParseCode("(+++.>)[.]+.", pbrain);
+    assert(uncalled.GetInstructions()[1].operation == bt_operation::btoOPT_NoOperation && uncalled.GetInstructions()[2].operation == bt_operation::btoEndFunction);
+    assert(uncalled.GetInstructions()[3].operation == bt_operation::btoOPT_Increment);
+
+    //heap runs, the cells are pushed and popped at once
+    ParserBase runs = ParseCode("+>++>+++<<&>&>&>^>^>^<<%", optimized);
+    assert(std::count_if(runs.GetInstructions().begin(), runs.GetInstructions().end(), [](const bt_instruction& ins) {
+        return (ins.operation == bt_operation::btoOPT_PushRun || ins.operation == bt_operation::btoOPT_PopRun) && ins.offset == 2 && ins.repetitions == 3; }) == 2);
+    assert(RunCode("+>++>+++<<&>&>&>^>^>^:<:<:", optimized) == "123");
+    assert(RunCode("+>++>+++&<&<&>>>^<^<^<^:>:>:>:", optimized) == "0321"); //the fourth pop finds the heap empty
+    assert(RunCode("+>++>+++&<&<&>>>^<^<^<^:>:>:>:", threaded) == "0321");
+
+    //shared heap, eight threads push and swap at the same time, the main one takes the cells after the join
+    const std::string producers = "++++++++[>{[>>+++[<<~&~%>>-]!]<-]}>>++++++++++++++++++++++++[>~^[<<+>>-]<-]<:";
+    assert(RunCode(producers, settings) == "24");
+    assert(RunCode(producers, threaded) == "24");
+
+    //forks share the pages of the tape, every thread sees only its own writes after the fork
+    const std::string snapshots = "++++[>>>+<<<>{[>+~&!]<-]}>>>>~^[<+>-]<>~^[<+>-]<>~^[<+>-]<>~^[<+>-]<:";
+    assert(RunCode(snapshots, settings) == "18");
+    assert(RunCode(snapshots, threaded) == "18");
+
+    //forks joined at once run in place, the spinning one gets its sibling a thread
+    const std::string siblings = "{[[-]>+[<~^[>-<[-]]>]+++++:!]{[+++++++~&!]}";
+    assert(RunCode(siblings, settings) == "5");
+    assert(RunCode(siblings, threaded) == "5");
+
+    //forks as tasks of the worker pool
+    Settings pooled = threaded;
+    pooled.OP_threads = thread_option::toPool;
+    assert(RunCode(producers, pooled) == "24");
+    assert(RunCode(snapshots, pooled) == "18");
+
+    Settings fibers = threaded;
+    fibers.OP_threads = thread_option::toFiber;
+    assert(RunCode(producers, fibers) == "24");
+    assert(RunCode(snapshots, fibers) == "18");
+
+    //blocking heap, the consumers forked first wait for the producers, a pop nobody can feed is a deadlock
+    Settings blocking = threaded;
+    blocking.OP_blocking_heap = true;
+    const std::string pipeline = "++++[>{[[-]>+++++[>+++++[>~^[<<<+>>>-]<-]<-]<~&!]<-]++++[>{[>+++++[>+++++[<<~&>>-]<-]!]<-]}>>++++[>~^[<<<+>>>-]<-]<<:";
+    assert(RunCode(pipeline, blocking) == "100");
+    assert(RunCode("{[~^:!]}+:", blocking) == "1");
+    blocking.OP_threads = thread_option::toPool;
+    assert(RunCode(pipeline, blocking) == "100");
+    blocking.OP_threads = thread_option::toFiber;
+    assert(RunCode(pipeline, blocking) == "100");
+
+    //a fork copies the tape once, a move hands the cells over
+    MemoryTape<char, mem_option::moLimited, eof_option::eoZero> tape(16);
+    tape.Increment(3);
+    MemoryTape<char, mem_option::moLimited, eof_option::eoZero> copy(tape);
+    copy.Increment(1);
+    MemoryTape<char, mem_option::moLimited, eof_option::eoZero> moved(std::move(copy));
+    assert(*tape.GetValue() == 3 && *moved.GetValue() == 4 && copy.GetValue() == nullptr);
+
+    //function table, direct for small cells and hashed (growing past 8 functions) for 32 bit cells
+    const std::string functions = ">" + std::string(66, '+') + "<" + std::string(20, '+') + "[(>.<)-]+++++:[-](>+.<):";
+    for (cellsize_option cs : { cellsize_option::cs8, cellsize_option::csu16, cellsize_option::cs32 }) {
+        Settings table = pbrain;
+        table.OP_cellsize = cs;
+        assert(RunCode(functions, table) == "BC");
+    }
+
+    //calls on a known cell value, small functions are copied in, the others called directly
+    std::string big = ">";
+    for (int i = 0; i < 20; ++i)
+        big += "+.";
+    big += "<";
+    ParserBase calls = ParseCode("+(>+.<)+(" + big + ")[-]+:[-]++:", pbrain);
+    const std::string called = RunParsed(calls, pbrain);
+    CodeAnalyser(calls).ResolveCalls();
+    auto count = [&calls](bt_operation op) {
+        return std::count_if(calls.GetInstructions().begin(), calls.GetInstructions().end(), [op](const bt_instruction& ins) { return ins.operation == op; });
+    };
+    assert(count(bt_operation::btoCallFunction) == 0 && count(bt_operation::btoOPT_CallFunction) == 1);
+    assert(RunParsed(calls, pbrain) == called);
+
+    //tail calls reuse the frame, so the recursion goes deeper than the call stack limit
+    Settings deep = pbrain;
+    deep.OP_cellsize = cellsize_option::cs32;
+    const std::string countdown = ">+([-]++>-[<->>]<[<]>:)+()[-]>>" + std::string(200, '+') + "[<" + std::string(500, '+') + ">-]<<+:>>" + std::string(65, '+') + ".";
+    assert(RunCode(countdown, deep) == "A");
+    deep.OP_engine = engine_option::enThreaded;
+    assert(RunCode(countdown, deep) == "A");
+
+    //partial evaluation, the loop before the input is replaced by the cells it left
+    ParserBase prefix = ParseCode("++++++[>++++++++<-]>+.,.", optimized);
+    assert(PrefixEvaluator<char>(30000).Evaluate(prefix));
+    const CodeTape& evaluated = prefix.GetInstructions();
+    assert(std::none_of(evaluated.begin(), evaluated.end(), [](const bt_instruction& ins) { return ins.operation == bt_operation::btoBeginLoop; }));
+    assert(evaluated.front().operation == bt_operation::btoOPT_Increment && evaluated.front().repetitions == '1');
+    assert(std::count_if(evaluated.begin(), evaluated.end(), [](const bt_instruction& ins) { return ins.operation == bt_operation::btoAsciiRead; }) == 1);
+    ParserBase input_first = ParseCode(",[.,]", optimized);
+    assert(!PrefixEvaluator<char>(30000).Evaluate(input_first));
+
+    //C backend
+    std::ostringstream c_code;
+    CodeGenerator(cellsize_option::cs8, mem_option::moLimited, eof_option::eoZero, 30000)
+        .Generate(GetParser("+++(>++++++[<++++++++>-]<.){*}").GetInstructions(), c_code);
+    assert(c_code.str().find("static void bt_f3(bt_proc* P, int entry)") != std::string::npos);
+    assert(c_code.str().find("case 28: goto L28;") != std::string::npos); //fork resume point
+    c_code.str("");
+    CodeGenerator(cellsize_option::cs8, mem_option::moLimited, eof_option::eoZero, 30000)
+        .Generate(GetParser("+(>-[<*]<*)").GetInstructions(), c_code);
+    assert(c_code.str().find("if (!bt_call(P)) return;") != std::string::npos); //inside the loop
+    assert(c_code.str().find("P->tail = bt_lookup(P); return;") != std::string::npos);
+
     return 0;
-}
\ No newline at end of file
+}